@@ -0,0 +1,16 @@
+#!/bin/bash
+
+## Runs the same workloads against the list (libring) and the block deque
+## (libring_deque) backend
+
+TARGET="benchmarks-backend"
+SRC="benchmarks_backend.c"
+
+## FLAGS
+CFLAGS="-O2 -std=c99 -pipe -pthread -Winline -Wall -Wextra -Werror -Wno-unused"
+CC="gcc"
+
+make && $CC $CFLAGS -o $TARGET-list $SRC libring.a && \
+	$CC $CFLAGS -DRING_DEQUE -o $TARGET-deque $SRC libring_deque.a && \
+	./$TARGET-list && ./$TARGET-deque
+
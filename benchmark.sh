@@ -0,0 +1,13 @@
+#!/bin/bash
+
+## Runs all benchmarks, or only the ones named on the command line
+
+TARGET="benchmarks"
+SRC="benchmarks.c"
+
+## FLAGS
+CFLAGS="-O2 -std=c99 -pipe -pthread -Winline -Wall -Wextra -Werror -Wno-unused"
+LDLIBS="libring.a -lrt"
+CC="gcc"
+
+make && $CC $CFLAGS -o $TARGET $SRC $LDLIBS && ./$TARGET "$@"
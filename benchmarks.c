@@ -0,0 +1,1172 @@
+/**
+ * @file Ring data structure benchmarks
+ * @author Markus Wanke 
+ */
+
+#define _GNU_SOURCE
+
+/* ---- System Header -------------------------------------------------------------- */
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+
+/* ---- Own Header ----------------------------------------------------------------- */
+#include "ring.h"
+#include "ring_sharded.h"
+#include "ring_pool.h"
+#include "ring_shm.h"
+#include "ring_sync.h"
+#include "ring_typed.h"
+
+/* ---- Helper Functions ----------------------------------------------------------- */
+
+#define ES_none   "\033[0m"
+#define ES_bold   "\033[1m"
+#define ES_blue   "\033[34m"
+#define ES_white  "\033[37m"
+#define pinfo(format, ...) fprintf(stderr, ES_bold ES_blue "INFO " ES_none ES_white format ES_none "\n", ## __VA_ARGS__)
+#define presult(name, format, ...) printf("%-40s " format "\n", name, ## __VA_ARGS__)
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Keeps the compiler from dropping the measured loops
+static volatile uint64_t sink;
+
+/* ---- Benchmarks ----------------------------------------------------------------- */
+
+#define BENCH_ELEMENTS (1 << 20)
+#define BENCH_NOISE    (1 << 16)
+
+int32_t a[BENCH_ELEMENTS];
+
+// -----------------------------------------------------------------------------
+/**
+ * Nanoseconds per element for a full ring_iterator walk. Best of 5.
+ */
+static double iterate_ns(Ring r)
+{
+	double best = 1e9;
+
+	for (int rep = 0; rep < 5; ++rep)
+	{
+		uint64_t sum = 0;
+		double t = now();
+
+		for (ring_iterator(r))
+			sum += *(int32_t*)ring_index;
+
+		t = now() - t;
+		sink = sum;
+
+		if (t < best)
+			best = t;
+	}
+
+	return best * 1e9 / ring_size(r);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Rotates the ring through pop/append/push/extract/insert while unrelated
+ * allocations come and go, so the nodes end up scattered over the heap.
+ */
+static void age(Ring r, uint64_t rounds)
+{
+	void** noise = calloc(BENCH_NOISE, sizeof(void*));
+
+	for (uint64_t i = 0; i < rounds; ++i)
+	{
+		uint32_t k = rand() % BENCH_NOISE;
+
+		free(noise[k]);
+		noise[k] = malloc(8 + rand() % 120);
+
+		switch (rand() % 4)
+		{
+			break; case 0:
+			case 1:
+				ring_append(r, ring_pop(r));
+			break; case 2:
+				ring_push(r, ring_extract(r, rand() % 64));
+			break; case 3:
+				ring_insert_at(r, ring_extract(r, rand() % 64), rand() % 64);
+		}
+	}
+
+	for (uint32_t k = 0; k < BENCH_NOISE; ++k)
+		free(noise[k]);
+
+	free(noise);
+}
+
+void b_compact(void)
+{
+	Ring fresh = ring_create();
+	Ring aged = ring_create();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+	{
+		ring_append(fresh, a + i);
+		ring_append(aged, a + i);
+	}
+
+	age(aged, 4 * BENCH_ELEMENTS);
+
+	presult("compact: fresh ring iterate", "%6.2f ns/elem", iterate_ns(fresh));
+	presult("compact: aged ring iterate", "%6.2f ns/elem", iterate_ns(aged));
+
+	double t = now();
+	ring_compact(aged);
+	t = now() - t;
+
+	presult("compact: ring_compact", "%6.2f ms", t * 1e3);
+	presult("compact: compacted ring iterate", "%6.2f ns/elem", iterate_ns(aged));
+
+	ring_destroy(fresh, NULL);
+	ring_destroy(aged, NULL);
+}
+
+
+#define BENCH_SHARDED_OPS (1 << 20)
+
+struct sharded_arg
+{
+	RingSharded sharded;
+	Ring single;
+	pthread_mutex_t* lock;
+	uint64_t ops;
+};
+
+// Producer/consumer mix: two appends, two pops per round
+static void* sharded_worker(void* arg)
+{
+	struct sharded_arg* sa = arg;
+
+	for (uint64_t i = 0; i < sa->ops; i += 2)
+	{
+		if (sa->sharded)
+		{
+			ring_sharded_append(sa->sharded, a + i % BENCH_ELEMENTS);
+			ring_sharded_append(sa->sharded, a + i % BENCH_ELEMENTS);
+			ring_sharded_pop(sa->sharded);
+			ring_sharded_pop(sa->sharded);
+		}
+		else
+		{
+			for (int k = 0; k < 2; ++k)
+			{
+				pthread_mutex_lock(sa->lock);
+				ring_append(sa->single, a + i % BENCH_ELEMENTS);
+				pthread_mutex_unlock(sa->lock);
+			}
+
+			for (int k = 0; k < 2; ++k)
+			{
+				pthread_mutex_lock(sa->lock);
+				ring_pop(sa->single);
+				pthread_mutex_unlock(sa->lock);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+// Million operations per second with n threads
+static double sharded_run(uint32_t n, bool sharded)
+{
+	pthread_t threads[64];
+	struct sharded_arg arg;
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+	arg.sharded = sharded ? ring_sharded_create(n) : NULL;
+	arg.single = sharded ? NULL : ring_create();
+	arg.lock = &lock;
+	arg.ops = BENCH_SHARDED_OPS / n;
+
+	double t = now();
+
+	for (uint32_t i = 0; i < n; ++i)
+		pthread_create(threads + i, NULL, sharded_worker, &arg);
+
+	for (uint32_t i = 0; i < n; ++i)
+		pthread_join(threads[i], NULL);
+
+	t = now() - t;
+
+	if (sharded)
+		ring_sharded_destroy(arg.sharded, NULL);
+	else
+		ring_destroy(arg.single, NULL);
+
+	return 2.0 * BENCH_SHARDED_OPS / t / 1e6;
+}
+
+void b_sharded(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t max = cpus < 4 ? 4 : (cpus > 64 ? 64 : cpus);
+
+	for (uint32_t n = 1; n <= max; n *= 2)
+	{
+		char name[64];
+
+		snprintf(name, sizeof(name), "sharded: %2u threads mutex ring", n);
+		presult(name, "%6.2f Mops/s", sharded_run(n, false));
+		snprintf(name, sizeof(name), "sharded: %2u threads ring_sharded", n);
+		presult(name, "%6.2f Mops/s", sharded_run(n, true));
+	}
+}
+
+
+void b_array(void)
+{
+	cp* arr = malloc(BENCH_ELEMENTS * sizeof(cp));
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		arr[i] = a + i;
+
+	double t = now();
+	Ring r = ring_create();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, arr[i]);
+
+	presult("array: load by ring_append", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	t = now();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		arr[i] = ring_pop(r);
+
+	presult("array: unload by ring_pop", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+	ring_destroy(r, NULL);
+
+	t = now();
+	r = ring_from_array(arr, BENCH_ELEMENTS);
+	presult("array: load by ring_from_array", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	t = now();
+	ring_to_array(r, arr, true);
+	presult("array: unload by ring_to_array", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	ring_destroy(r, NULL);
+	free(arr);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Positional loops that used to restart at r->first for every call.
+ */
+void b_at(void)
+{
+	Ring r = ring_create();
+	uint64_t sum = 0;
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, a + i);
+
+	double t = now();
+
+	for (uint64_t i = 0; i < ring_size(r); ++i)
+		sum += *(int32_t*)ring_at(r, i);
+
+	sink = sum;
+	presult("at: ring_at for i = 0..n", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	t = now();
+
+	for (uint64_t i = 1; i < ring_size(r); i += 2)
+		ring_insert_at(r, a, i);
+
+	presult("at: ring_insert_at every second", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	t = now();
+
+	for (uint64_t i = 1; i < ring_size(r); ++i)
+		ring_extract(r, i);
+
+	presult("at: ring_extract every second", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	RingCursor c;
+
+	sum = 0;
+	t = now();
+
+	for (ring_cursor_init(r, &c); ring_cursor_valid(&c); ring_cursor_advance(&c))
+		sum += *(int32_t*)ring_cursor_get(&c);
+
+	sink = sum;
+	presult("at: RingCursor walk", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	ring_destroy(r, NULL);
+}
+
+
+// Scalar reference: one compare per ring_iterator step
+static uint64_t count_eq_iterator(Ring r, cp c)
+{
+	uint64_t res = 0;
+
+	for (ring_iterator(r))
+		res += ring_index == c;
+
+	return res;
+}
+
+void b_find(void)
+{
+	Ring r = ring_create();
+	double t;
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, a + i % 1000);
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		const char* what = pass ? "compacted" : "heap";
+		char name[64];
+
+		t = now();
+		for (int rep = 0; rep < 10; ++rep)
+			sink += count_eq_iterator(r, a + 7);
+		snprintf(name, sizeof(name), "find: %s ring_iterator compare", what);
+		presult(name, "%6.2f ns/elem", (now() - t) * 1e8 / BENCH_ELEMENTS);
+
+		t = now();
+		for (int rep = 0; rep < 10; ++rep)
+			sink += ring_count_eq(r, a + 7);
+		snprintf(name, sizeof(name), "find: %s ring_count_eq", what);
+		presult(name, "%6.2f ns/elem", (now() - t) * 1e8 / BENCH_ELEMENTS);
+
+		ring_compact(r);
+	}
+
+	ring_destroy(r, NULL);
+}
+
+
+// Bytes currently allocated from the heap
+static uint64_t heap_used(void)
+{
+	return mallinfo2().uordblks + mallinfo2().hblkhd;
+}
+
+void b_pool(void)
+{
+	uint64_t before;
+	double t;
+	uint64_t sum;
+
+	// heap ring
+	before = heap_used();
+	Ring r = ring_create();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, a + i);
+
+	presult("pool: heap ring memory", "%6.2f bytes/elem", (double)(heap_used() - before) / BENCH_ELEMENTS);
+	presult("pool: heap ring iterate", "%6.2f ns/elem", iterate_ns(r));
+
+	// the same ring in one arena block
+	ring_compact(r);
+	presult("pool: compacted ring memory", "%6.2f bytes/elem", (double)(heap_used() - before) / BENCH_ELEMENTS);
+	presult("pool: compacted ring iterate", "%6.2f ns/elem", iterate_ns(r));
+	ring_destroy(r, NULL);
+
+	// 8 byte nodes
+	before = heap_used();
+	RingPool pool = ring_pool_create(a, sizeof(*a));
+	PRing p = pring_create(pool);
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		pring_append(p, a + i);
+
+	presult("pool: pring memory", "%6.2f bytes/elem", (double)(heap_used() - before) / BENCH_ELEMENTS);
+
+	double best = 1e9;
+
+	for (int rep = 0; rep < 5; ++rep)
+	{
+		sum = 0;
+		t = now();
+
+		for (pring_iterator(p))
+			sum += *(int32_t*)pring_index;
+
+		t = now() - t;
+		sink = sum;
+		best = t < best ? t : best;
+	}
+
+	presult("pool: pring iterate", "%6.2f ns/elem", best * 1e9 / BENCH_ELEMENTS);
+
+	pring_destroy(p, NULL);
+	ring_pool_destroy(pool);
+}
+
+
+#define BENCH_CACHE_OPS   (1 << 22)
+#define BENCH_CACHE_BATCH 256
+
+struct cache_arg
+{
+	Ring shared;
+	pthread_mutex_t lock;
+};
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu % sysconf(_SC_NPROCESSORS_ONLN), &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Allocates on cpu 0, batches go to the consumer by ring_concat
+static void* cache_producer(void* arg)
+{
+	struct cache_arg* ca = arg;
+
+	pin(0);
+
+	for (uint64_t i = 0; i < BENCH_CACHE_OPS; i += BENCH_CACHE_BATCH)
+	{
+		Ring batch = ring_create();
+
+		for (uint32_t k = 0; k < BENCH_CACHE_BATCH; ++k)
+			ring_append(batch, a + k);
+
+		for (;;)
+		{
+			pthread_mutex_lock(&ca->lock);
+
+			if (ring_size(ca->shared) < 4 * BENCH_CACHE_BATCH)
+			{
+				ca->shared = ring_concat(ca->shared, batch);
+				pthread_mutex_unlock(&ca->lock);
+				break;
+			}
+
+			pthread_mutex_unlock(&ca->lock);
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+// Frees on cpu 1
+static void* cache_consumer(void* arg)
+{
+	struct cache_arg* ca = arg;
+	Ring mine = ring_create();
+	uint64_t got = 0;
+
+	pin(1);
+
+	while (got < BENCH_CACHE_OPS)
+	{
+		pthread_mutex_lock(&ca->lock);
+
+		Ring tmp = ca->shared;
+		ca->shared = mine;
+		mine = tmp;
+
+		pthread_mutex_unlock(&ca->lock);
+
+		if (ring_is_empty(mine))
+			sched_yield();
+
+		while (!ring_is_empty(mine))
+		{
+			ring_pop(mine);
+			got += 1;
+		}
+	}
+
+	ring_destroy(mine, NULL);
+
+	return NULL;
+}
+
+// Million nodes per second from producer to consumer
+static double cache_run(bool cache)
+{
+	pthread_t prod, cons;
+	struct cache_arg ca;
+
+	ring_node_cache(cache);
+	ring_node_cache_trim();
+
+	ca.shared = ring_create();
+	pthread_mutex_init(&ca.lock, NULL);
+
+	double t = now();
+
+	pthread_create(&prod, NULL, cache_producer, &ca);
+	pthread_create(&cons, NULL, cache_consumer, &ca);
+	pthread_join(prod, NULL);
+	pthread_join(cons, NULL);
+
+	t = now() - t;
+
+	ring_destroy(ca.shared, NULL);
+	pthread_mutex_destroy(&ca.lock);
+
+	return BENCH_CACHE_OPS / t / 1e6;
+}
+
+void b_cache(void)
+{
+	presult("cache: cross thread, glibc malloc", "%6.2f Mnodes/s", cache_run(false));
+	presult("cache: cross thread, node cache", "%6.2f Mnodes/s", cache_run(true));
+}
+
+
+#define BENCH_HUGE_ELEMENTS (1 << 22)
+#define BENCH_HUGE_LANES    64
+
+static void nop_free(cp c)
+{
+	sink += (uintptr_t)c;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Builds a ring from 64 interleaved lanes, neighbours in the list are 1 KiB
+ * apart in the arena and a walk touches a new 4 KiB page every 4 nodes.
+ */
+static Ring interleaved(RingArena arena)
+{
+	Ring lanes[BENCH_HUGE_LANES];
+
+	for (int k = 0; k < BENCH_HUGE_LANES; ++k)
+		lanes[k] = arena ? ring_create_in(arena) : ring_create();
+
+	for (uint32_t i = 0; i < BENCH_HUGE_ELEMENTS; ++i)
+		ring_append(lanes[i % BENCH_HUGE_LANES], a + i % BENCH_ELEMENTS);
+
+	return ring_concat_n(lanes, BENCH_HUGE_LANES);
+}
+
+static void huge_run(const char* name, RingArena arena)
+{
+	char label[64];
+	Ring r = interleaved(arena);
+
+	if (arena)
+		ring_arena_destroy(arena);
+
+	snprintf(label, sizeof(label), "huge: %s iterate", name);
+	presult(label, "%6.2f ns/elem", iterate_ns(r));
+
+	double t = now();
+	ring_destroy(r, nop_free);
+
+	snprintf(label, sizeof(label), "huge: %s destroy", name);
+	presult(label, "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_HUGE_ELEMENTS);
+}
+
+void b_huge(void)
+{
+	ring_node_cache(false);
+
+	huge_run("heap ring", NULL);
+	huge_run("4 KiB page arena", ring_arena_create(BENCH_HUGE_ELEMENTS));
+	huge_run("huge page arena", ring_arena_create_huge(BENCH_HUGE_ELEMENTS));
+
+	ring_node_cache(true);
+}
+
+
+#define BENCH_DESTROY_STEP 4096
+
+static Ring destroy_ring(void)
+{
+	Ring r = ring_create();
+
+	for (uint32_t i = 0; i < BENCH_HUGE_ELEMENTS; ++i)
+		ring_append(r, a + i % BENCH_ELEMENTS);
+
+	return r;
+}
+
+// Time the calling thread is blocked by the teardown of a 4M element ring
+void b_destroy(void)
+{
+	Ring r = destroy_ring();
+	double t = now();
+
+	ring_destroy(r, nop_free);
+	presult("destroy: ring_destroy", "%8.3f ms", (now() - t) * 1e3);
+
+	r = destroy_ring();
+	t = now();
+	ring_destroy_async(r, nop_free);
+	presult("destroy: ring_destroy_async call", "%8.3f ms", (now() - t) * 1e3);
+
+	t = now();
+	ring_destroy_wait();
+	presult("destroy: reclaimer finished after", "%8.3f ms", (now() - t) * 1e3);
+
+	double worst = 0;
+	r = destroy_ring();
+
+	for (bool done = false; !done; )
+	{
+		t = now();
+		done = ring_destroy_step(r, nop_free, BENCH_DESTROY_STEP);
+		t = now() - t;
+		worst = t > worst ? t : worst;
+	}
+
+	presult("destroy: worst ring_destroy_step(4096)", "%8.3f ms", worst * 1e3);
+}
+
+
+#define BENCH_ROTATE_RING 4096
+
+// Round robin over 4096 entities, one rotation per step
+void b_rotate(void)
+{
+	Ring r = ring_create();
+
+	for (uint32_t i = 0; i < BENCH_ROTATE_RING; ++i)
+		ring_append(r, a + i);
+
+	ring_node_cache(false);
+
+	double t = now();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, ring_pop(r));
+
+	presult("rotate: append(pop), malloc", "%6.2f ns/step", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	ring_node_cache(true);
+	t = now();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, ring_pop(r));
+
+	presult("rotate: append(pop), node cache", "%6.2f ns/step", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	t = now();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_rotate(r, 1);
+
+	presult("rotate: ring_rotate(r, 1)", "%6.2f ns/step", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	ring_destroy(r, NULL);
+}
+
+
+#define BENCH_SHM_MSGS (1 << 20)
+#define BENCH_SHM_MSG 64
+
+// Process to process handoff of 64 byte messages, pipe vs shared memory queue
+void b_shm(void)
+{
+	char name[64], buf[BENCH_SHM_MSG];
+	int fds[2];
+
+	memset(buf, 1, sizeof(buf));
+
+	if (pipe(fds))
+		return;
+
+	double t = now();
+
+	if (fork() == 0)
+	{
+		close(fds[0]);
+		for (uint32_t i = 0; i < BENCH_SHM_MSGS; ++i)
+			if (write(fds[1], buf, sizeof(buf)) != sizeof(buf))
+				_exit(1);
+		_exit(0);
+	}
+
+	close(fds[1]);
+
+	for (uint32_t i = 0; i < BENCH_SHM_MSGS; ++i)
+		for (ssize_t got = 0; got < BENCH_SHM_MSG; )
+			got += read(fds[0], buf + got, sizeof(buf) - got);
+
+	wait(NULL);
+	close(fds[0]);
+	presult("shm: pipe", "%6.2f Mmsg/s", BENCH_SHM_MSGS / (now() - t) / 1e6);
+
+	snprintf(name, sizeof(name), "/libring-bench-%d", (int)getpid());
+
+	RingShm s = ring_shm_create(name, 256, BENCH_SHM_MSG);
+
+	if (!s)
+		return;
+
+	t = now();
+
+	if (fork() == 0)
+	{
+		for (uint32_t i = 0; i < BENCH_SHM_MSGS; ++i)
+		{
+			char* m = ring_shm_reserve_wait(s);
+			memset(m, 1, BENCH_SHM_MSG);
+			ring_shm_append(s, m);
+		}
+		_exit(0);
+	}
+
+	uint64_t sum = 0;
+
+	for (uint32_t i = 0; i < BENCH_SHM_MSGS; ++i)
+	{
+		char* m = ring_shm_pop_wait(s);
+		sum += m[i % BENCH_SHM_MSG];
+		ring_shm_release(s, m);
+	}
+
+	wait(NULL);
+	sink = sum;
+	presult("shm: ring_shm", "%6.2f Mmsg/s", BENCH_SHM_MSGS / (now() - t) / 1e6);
+
+	ring_shm_close(s);
+	ring_shm_unlink(name);
+}
+
+
+#define BENCH_MERGE_K 32
+
+static int merge_cmp(cp x, cp y)
+{
+	return *(int32_t*)x - *(int32_t*)y;
+}
+
+// BENCH_MERGE_K sorted rings, element i goes to a random one
+static void merge_rings(Ring* rings)
+{
+	for (int j = 0; j < BENCH_MERGE_K; ++j)
+		rings[j] = ring_create();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(rings[rand() % BENCH_MERGE_K], a + i);
+}
+
+// Merge of 32 sorted producer rings into one
+void b_merge(void)
+{
+	Ring rings[BENCH_MERGE_K];
+
+	merge_rings(rings);
+
+	Ring out = ring_create();
+	double t = now();
+
+	for (;;)
+	{
+		int best = -1;
+
+		for (int j = 0; j < BENCH_MERGE_K; ++j)
+			if (!ring_is_empty(rings[j]) &&
+				(best < 0 || merge_cmp(ring_first(rings[j]), ring_first(rings[best])) < 0))
+				best = j;
+
+		if (best < 0)
+			break;
+
+		ring_append(out, ring_pop(rings[best]));
+	}
+
+	presult("merge: pop/append, linear scan", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	ring_destroy(out, NULL);
+	for (int j = 0; j < BENCH_MERGE_K; ++j)
+		ring_destroy(rings[j], NULL);
+
+	merge_rings(rings);
+	t = now();
+	out = ring_merge_sorted(rings, BENCH_MERGE_K, merge_cmp);
+	presult("merge: ring_merge_sorted", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+	ring_destroy(out, NULL);
+
+	merge_rings(rings);
+
+	uint64_t sum = 0;
+	RingMerge m = ring_merge_open(rings, BENCH_MERGE_K, merge_cmp);
+	cp c;
+
+	t = now();
+	while ((c = ring_merge_next(m)))
+		sum += *(int32_t*)c;
+
+	presult("merge: ring_merge_next", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	sink = sum;
+	ring_merge_close(m);
+	for (int j = 0; j < BENCH_MERGE_K; ++j)
+		ring_destroy(rings[j], NULL);
+}
+
+
+#define BENCH_BUCKETS 16
+
+static uint64_t bucket_key(cp c, void* ud)
+{
+	(void)ud;
+	return (uint64_t)*(int32_t*)c * 2654435761u >> 7;
+}
+
+static bool bucket_is(cp c, void* ud)
+{
+	return bucket_key(c, NULL) % BENCH_BUCKETS == *(uint64_t*)ud;
+}
+
+// Hash partition of 1M elements into 16 rings
+void b_bucketize(void)
+{
+	Ring r = ring_create();
+	Ring b[BENCH_BUCKETS];
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, a + i);
+
+	// both start from nodes in list order
+	ring_compact(r);
+
+	double t = now();
+
+	for (uint64_t j = 0; j + 1 < BENCH_BUCKETS; ++j)
+		b[j] = ring_remove_selected(r, bucket_is, &j);
+	b[BENCH_BUCKETS - 1] = r;
+
+	presult("bucketize: ring_remove_selected x15", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	for (int j = 0; j < BENCH_BUCKETS; ++j)
+		ring_destroy(b[j], NULL);
+
+	r = ring_create();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, a + i);
+
+	ring_compact(r);
+
+	for (int j = 0; j < BENCH_BUCKETS; ++j)
+		b[j] = ring_create();
+
+	t = now();
+	ring_bucketize(r, b, BENCH_BUCKETS, bucket_key, NULL);
+	presult("bucketize: ring_bucketize", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	ring_destroy(r, NULL);
+	for (int j = 0; j < BENCH_BUCKETS; ++j)
+		ring_destroy(b[j], NULL);
+}
+
+
+#define BENCH_NUMA_NODES 64
+
+// Walk over a ring placed on each NUMA node, from a thread on one of them
+void b_numa(void)
+{
+	unsigned cpu = 0, here = 0;
+	char name[64];
+
+	syscall(SYS_getcpu, &cpu, &here, NULL);
+
+	Ring r = ring_create();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, a + i);
+
+	age(r, BENCH_ELEMENTS);
+
+	presult("numa: iterate aged heap ring", "%6.2f ns/elem", iterate_ns(r));
+
+	for (int node = 0; node < BENCH_NUMA_NODES; ++node)
+	{
+		double t = now();
+
+		if (!ring_migrate(r, node))
+			continue;
+
+		t = now() - t;
+
+		snprintf(name, sizeof(name), "numa: ring_migrate to node %d", node);
+		presult(name, "%6.2f ms", t * 1e3);
+
+		snprintf(name, sizeof(name), "numa: iterate from node %u, ring on %d", here, node);
+		presult(name, "%6.2f ns/elem", iterate_ns(r));
+	}
+
+	ring_destroy(r, NULL);
+}
+
+struct BenchPair
+{
+	int64_t key;
+	int64_t value;
+};
+
+RING_DEFINE(BenchIntRing, int32_t)
+RING_DEFINE(BenchPairRing, struct BenchPair)
+
+// Small values stored inline in typed nodes against malloc'd values behind cp
+void b_typed(void)
+{
+	uint64_t sum = 0;
+	double t = now();
+	Ring r = ring_create();
+
+	for (int32_t i = 0; i < BENCH_ELEMENTS; ++i)
+	{
+		int32_t* v = malloc(sizeof(*v));
+
+		*v = i;
+		ring_append(r, v);
+	}
+
+	presult("typed: Ring + malloc'd int append", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+	presult("typed: Ring + malloc'd int iterate", "%6.2f ns/elem", iterate_ns(r));
+
+	t = now();
+
+	while (!ring_is_empty(r))
+	{
+		int32_t* v = ring_pop(r);
+
+		sum += *v;
+		free(v);
+	}
+
+	sink = sum;
+	presult("typed: Ring + malloc'd int pop", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	ring_destroy(r, NULL);
+
+	BenchIntRing ir = BenchIntRing_create();
+	int32_t v;
+
+	t = now();
+
+	for (int32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		BenchIntRing_append(ir, i);
+
+	presult("typed: IntRing append", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	double best = 1e9;
+
+	for (int rep = 0; rep < 5; ++rep)
+	{
+		t = now();
+
+		for (ring_typed_iterator(BenchIntRing, ir))
+			sum += ring_typed_index;
+
+		t = now() - t;
+		sink = sum;
+
+		if (t < best)
+			best = t;
+	}
+
+	presult("typed: IntRing iterate", "%6.2f ns/elem", best * 1e9 / BENCH_ELEMENTS);
+
+	t = now();
+
+	while (BenchIntRing_pop(ir, &v))
+		sum += v;
+
+	sink = sum;
+	presult("typed: IntRing pop", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	BenchIntRing_destroy(ir);
+
+	BenchPairRing pr = BenchPairRing_create();
+	struct BenchPair p = { 0, 0 };
+
+	t = now();
+
+	for (int32_t i = 0; i < BENCH_ELEMENTS; ++i)
+	{
+		p.key = i;
+		BenchPairRing_append(pr, p);
+	}
+
+	while (BenchPairRing_pop(pr, &p))
+		sum += p.key;
+
+	sink = sum;
+	presult("typed: 16 byte PairRing append + pop", "%6.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	BenchPairRing_destroy(pr);
+}
+
+
+#define BENCH_EVENT_MSGS (1 << 20)
+
+struct bench_event
+{
+	RingSync s;
+	// pipe written once per message, -1 for the eventfd of the queue
+	int wfd;
+};
+
+static void* event_producer(void* arg)
+{
+	struct bench_event* e = arg;
+	char one = 1;
+
+	for (uint32_t i = 0; i < BENCH_EVENT_MSGS; ++i)
+	{
+		ring_sync_append(e->s, a + i);
+
+		if (e->wfd >= 0 && write(e->wfd, &one, 1) != 1)
+			abort();
+	}
+
+	return NULL;
+}
+
+// Thread to event loop handoff: a pipe write per message against the
+// eventfd of ring_sync, signaled on the empty to non-empty transition only
+void b_eventfd(void)
+{
+	char buf[4096];
+	int fds[2];
+	pthread_t th;
+
+	if (pipe(fds))
+		return;
+
+	for (int mode = 0; mode < 2; ++mode)
+	{
+		struct bench_event e = { ring_sync_create(0, RING_REJECT), mode ? -1 : fds[1] };
+		int fd = mode ? ring_sync_fd(e.s) : fds[0];
+		int ep = epoll_create1(0);
+		struct epoll_event ev = { .events = EPOLLIN };
+		uint64_t sum = 0, got = 0, calls = 0;
+
+		if (fd < 0 || ep < 0)
+			return;
+
+		epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+
+		double t = now();
+
+		pthread_create(&th, NULL, event_producer, &e);
+
+		while (got < BENCH_EVENT_MSGS)
+		{
+			epoll_wait(ep, &ev, 1, -1);
+			calls += 2;
+
+			if (mode)
+			{
+				Ring r = ring_sync_pop_all(e.s);
+
+				for (ring_iterator(r))
+					sum += *(int32_t*)ring_index;
+
+				got += ring_size(r);
+				ring_destroy(r, NULL);
+			}
+			else
+			{
+				ssize_t n = read(fd, buf, sizeof(buf));
+
+				for (ssize_t i = 0; i < n; ++i)
+					sum += *(int32_t*)ring_sync_pop(e.s);
+
+				got += n > 0 ? n : 0;
+			}
+		}
+
+		pthread_join(th, NULL);
+		t = now() - t;
+		sink = sum;
+
+		// epoll_wait + read per wakeup, plus the producer writes
+		calls += mode ? ring_sync_signals(e.s) : BENCH_EVENT_MSGS;
+
+		presult(mode ? "eventfd: ring_sync_fd" : "eventfd: pipe per message", "%6.2f Mmsg/s, %5.3f syscalls/msg",
+				BENCH_EVENT_MSGS / t / 1e6, (double)calls / BENCH_EVENT_MSGS);
+
+		close(ep);
+		ring_sync_destroy(e.s, NULL);
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+
+/* ---- Main ----------------------------------------------------------------------- */
+
+struct bench
+{
+	const char* name;
+	void (*func)(void);
+};
+
+struct bench benches[] =
+{
+	{ "compact", b_compact },
+	{ "sharded", b_sharded },
+	{ "array", b_array },
+	{ "find", b_find },
+	{ "pool", b_pool },
+	{ "at", b_at },
+	{ "cache", b_cache },
+	{ "huge", b_huge },
+	{ "destroy", b_destroy },
+	{ "rotate", b_rotate },
+	{ "shm", b_shm },
+	{ "merge", b_merge },
+	{ "bucketize", b_bucketize },
+	{ "numa", b_numa },
+	{ "typed", b_typed },
+	{ "eventfd", b_eventfd },
+	{ NULL, NULL }
+};
+
+int main(int argc, char** argv)
+{
+	srand(42);
+
+	for (int i = 0; i < BENCH_ELEMENTS; ++i)
+		a[i] = i;
+
+	for (struct bench* b = benches; b->name; ++b)
+	{
+		bool run = argc < 2;
+
+		for (int i = 1; i < argc; ++i)
+			run |= !strcmp(argv[i], b->name);
+
+		if (!run)
+			continue;
+
+		pinfo("%s", b->name);
+		b->func();
+	}
+
+	return 0;
+}
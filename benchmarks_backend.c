@@ -0,0 +1,119 @@
+/**
+ * @file Workloads on the part of the interface both backends share. Built
+ * once against libring (ring.h) and once with -DRING_DEQUE against
+ * libring_deque (ring_deque.h), see benchmark-backends.sh
+ * @author Markus Wanke
+ */
+
+#define _GNU_SOURCE
+
+/* ---- System Header -------------------------------------------------------------- */
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* ---- Own Header ----------------------------------------------------------------- */
+#ifdef RING_DEQUE
+	#include "ring_deque.h"
+	#define BACKEND "deque"
+#else
+	#include "ring.h"
+	#define BACKEND "list"
+#endif
+
+/* ---- Helper Functions ----------------------------------------------------------- */
+
+#define presult(name, format, ...) printf("%-5s %-34s " format "\n", BACKEND, name, ## __VA_ARGS__)
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Keeps the compiler from dropping the measured loops
+static volatile uint64_t sink;
+
+/* ---- Benchmarks ----------------------------------------------------------------- */
+
+#define BENCH_ELEMENTS  (1 << 20)
+#define BENCH_POSITIONS (1 << 14)
+
+int32_t a[BENCH_ELEMENTS];
+
+int main(void)
+{
+	uint64_t sum = 0;
+
+	for (int i = 0; i < BENCH_ELEMENTS; ++i)
+		a[i] = i;
+
+	Ring r = ring_create();
+	double t = now();
+
+	for (uint32_t i = 0; i < BENCH_ELEMENTS; ++i)
+		ring_append(r, a + i);
+
+	presult("ring_append", "%7.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	t = now();
+
+	for (ring_iterator(r))
+		sum += *(int32_t*)ring_index;
+
+	sink = sum;
+	presult("ring_iterator", "%7.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	// random positions, no finger to continue from
+	srand(42);
+	t = now();
+
+	for (int i = 0; i < BENCH_POSITIONS; ++i)
+		sum += *(int32_t*)ring_at(r, (uint64_t)rand() % BENCH_ELEMENTS);
+
+	sink = sum;
+	presult("ring_at random", "%7.2f ns/op", (now() - t) * 1e9 / BENCH_POSITIONS);
+
+	t = now();
+
+	for (int i = 0; i < BENCH_POSITIONS / 16; ++i)
+		ring_insert_at(r, a, (uint64_t)rand() % ring_size(r));
+
+	presult("ring_insert_at random", "%7.2f us/op", (now() - t) * 1e6 / (BENCH_POSITIONS / 16));
+
+	t = now();
+
+	for (int i = 0; i < BENCH_POSITIONS / 16; ++i)
+		ring_extract(r, (uint64_t)rand() % ring_size(r));
+
+	presult("ring_extract random", "%7.2f us/op", (now() - t) * 1e6 / (BENCH_POSITIONS / 16));
+
+	t = now();
+
+	// O(n) each on the list
+	for (int i = 0; i < BENCH_POSITIONS / 16; ++i)
+		ring_push(r, ring_chop(r));
+
+	presult("ring_chop + ring_push", "%7.2f us/op", (now() - t) * 1e6 / (BENCH_POSITIONS / 16));
+
+	Ring s = ring_split_half(r);
+
+	t = now();
+	r = ring_concat(r, s);
+
+	presult("ring_concat of two halves", "%7.2f ms", (now() - t) * 1e3);
+
+	t = now();
+
+	while (!ring_is_empty(r))
+		sum += *(int32_t*)ring_pop(r);
+
+	sink = sum;
+	presult("ring_pop", "%7.2f ns/elem", (now() - t) * 1e9 / BENCH_ELEMENTS);
+
+	ring_destroy(r, NULL);
+
+	return 0;
+}
@@ -0,0 +1,496 @@
+/**
+ * @file Ring trace replay
+ *
+ * Replays a recorded sequence of ring.h operations against libring and
+ * reports throughput, latency percentiles per operation and peak memory.
+ *
+ *   replay gen <fifo|lifo|bursty|cancel> <ops> <trace>   synthetic trace
+ *   replay run <trace> [heap|nocache|arena|huge]         replay it
+ *
+ * Trace format, little endian:
+ *   "RTRC" | u32 version | u64 record count
+ *   records: u8 op [varint argument]
+ * PUSH and APPEND carry the element id, EXTRACT the position (taken modulo
+ * the size at replay time), REMOVE_SELECTED a modulus m: elements with
+ * id % m == 0 are removed. POP and CHOP have no argument.
+ */
+
+#define _GNU_SOURCE
+
+/* ---- System Header -------------------------------------------------------------- */
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* ---- Own Header ----------------------------------------------------------------- */
+#include "ring.h"
+
+/* ---- Helper Functions ----------------------------------------------------------- */
+
+#define presult(name, format, ...) printf("%-40s " format "\n", name, ## __VA_ARGS__)
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Resident set size in KiB, the current one or the peak since peak_reset
+static long rss_kib(const char* field)
+{
+	char line[256];
+	long res = 0;
+	FILE* f = fopen("/proc/self/status", "r");
+
+	while (f && fgets(line, sizeof(line), f))
+		if (!strncmp(line, field, strlen(field)))
+			res = strtol(line + strlen(field), NULL, 10);
+
+	if (f)
+		fclose(f);
+
+	return res;
+}
+
+static void peak_reset(void)
+{
+	FILE* f = fopen("/proc/self/clear_refs", "w");
+
+	if (f)
+		fputs("5", f), fclose(f);
+}
+
+// Keeps the compiler from dropping the replayed operations
+static volatile uint64_t sink;
+
+/* ---- Trace ---------------------------------------------------------------------- */
+
+#define TRACE_MAGIC "RTRC"
+#define TRACE_VERSION 1
+
+enum op
+{
+	OP_PUSH,
+	OP_APPEND,
+	OP_POP,
+	OP_CHOP,
+	OP_EXTRACT,
+	OP_REMOVE_SELECTED,
+	OP_COUNT
+};
+
+static const char* op_names[OP_COUNT] =
+{
+	"push", "append", "pop", "chop", "extract", "remove_selected"
+};
+
+struct record
+{
+	uint8_t op;
+	uint64_t arg;
+};
+
+static bool op_has_arg(uint8_t op)
+{
+	return op == OP_PUSH || op == OP_APPEND || op == OP_EXTRACT || op == OP_REMOVE_SELECTED;
+}
+
+static void put_varint(FILE* f, uint64_t v)
+{
+	for (; v >= 0x80; v >>= 7)
+		fputc((int)(v & 0x7f) | 0x80, f);
+
+	fputc((int)v, f);
+}
+
+static bool get_varint(FILE* f, uint64_t* v)
+{
+	*v = 0;
+
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int c = fgetc(f);
+
+		if (c == EOF)
+			return false;
+
+		*v |= (uint64_t)(c & 0x7f) << shift;
+
+		if (!(c & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+// Reads a whole trace, NULL on a malformed file
+static struct record* trace_load(const char* path, uint64_t* n)
+{
+	FILE* f = fopen(path, "rb");
+	char magic[4];
+	uint32_t version = 0;
+
+	if (!f)
+		return NULL;
+
+	if (fread(magic, 4, 1, f) != 1 || memcmp(magic, TRACE_MAGIC, 4) ||
+		fread(&version, 4, 1, f) != 1 || version != TRACE_VERSION ||
+		fread(n, 8, 1, f) != 1)
+	{
+		fclose(f);
+		return NULL;
+	}
+
+	// every record takes at least its op byte, the count can't be larger
+	long at = ftell(f);
+
+	if (at < 0 || fseek(f, 0, SEEK_END) || *n > SIZE_MAX / sizeof(struct record) - 1 ||
+		*n > (uint64_t)(ftell(f) - at) || fseek(f, at, SEEK_SET))
+	{
+		fclose(f);
+		return NULL;
+	}
+
+	struct record* res = malloc(*n * sizeof(*res) + 1);
+
+	for (uint64_t i = 0; res && i < *n; ++i)
+	{
+		int op = fgetc(f);
+
+		res[i].op = (uint8_t)op;
+		res[i].arg = 0;
+
+		if (op < 0 || op >= OP_COUNT || (op_has_arg(op) && !get_varint(f, &res[i].arg)))
+		{
+			free(res);
+			res = NULL;
+		}
+	}
+
+	fclose(f);
+
+	return res;
+}
+
+/* ---- Operations ---------------------------------------------------------------- */
+
+static bool selected(cp c, void* ud)
+{
+	return ((uintptr_t)c - 1) % *(uint64_t*)ud == 0;
+}
+
+// Executes one record, elements are id + 1 so that none is NULL
+static inline uint64_t apply(Ring r, const struct record* rec)
+{
+	switch (rec->op)
+	{
+		case OP_PUSH:
+			ring_push(r, (cp)(uintptr_t)(rec->arg + 1));
+			return 0;
+		case OP_APPEND:
+			ring_append(r, (cp)(uintptr_t)(rec->arg + 1));
+			return 0;
+		case OP_POP:
+			return (uintptr_t)ring_pop(r);
+		case OP_CHOP:
+			return (uintptr_t)ring_chop(r);
+		case OP_EXTRACT:
+			return ring_size(r) ? (uintptr_t)ring_extract(r, rec->arg % ring_size(r)) : 0;
+		case OP_REMOVE_SELECTED:
+		{
+			uint64_t m = rec->arg ? rec->arg : 1;
+			Ring gone = ring_remove_selected(r, selected, &m);
+			uint64_t res = ring_size(gone);
+
+			ring_destroy(gone, NULL);
+			return res;
+		}
+	}
+
+	return 0;
+}
+
+/* ---- Generator ------------------------------------------------------------------ */
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t rnd(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+// The generated operations run on a ring as well, so size is exact
+struct gen
+{
+	FILE* f;
+	Ring sim;
+	uint64_t n;
+	uint64_t size;
+	uint64_t next_id;
+};
+
+static void emit(struct gen* g, uint8_t op, uint64_t arg)
+{
+	fputc(op, g->f);
+
+	if (op_has_arg(op))
+		put_varint(g->f, arg);
+
+	struct record rec = { op, arg };
+
+	apply(g->sim, &rec);
+
+	g->n += 1;
+	g->size = ring_size(g->sim);
+}
+
+static void add(struct gen* g, uint8_t op)
+{
+	emit(g, op, g->next_id++);
+}
+
+#define GEN_DEPTH 1024
+#define GEN_BURST 4096
+
+// Steady queue of GEN_DEPTH pending elements
+static void gen_fifo(struct gen* g, uint64_t ops)
+{
+	while (g->n < ops)
+		if (g->size < GEN_DEPTH)
+			add(g, OP_APPEND);
+		else
+			add(g, OP_APPEND), emit(g, OP_POP, 0);
+}
+
+// Stack whose depth does a random walk
+static void gen_lifo(struct gen* g, uint64_t ops)
+{
+	while (g->n < ops)
+		if (g->size && rnd() % 2)
+			emit(g, OP_POP, 0);
+		else
+			add(g, OP_PUSH);
+}
+
+// Bursts of arrivals drained from both ends
+static void gen_bursty(struct gen* g, uint64_t ops)
+{
+	while (g->n < ops)
+	{
+		uint64_t burst = 1 + rnd() % GEN_BURST;
+
+		for (uint64_t i = 0; i < burst; ++i)
+			add(g, OP_APPEND);
+
+		while (g->size > GEN_DEPTH)
+			emit(g, rnd() % 4 ? OP_POP : OP_CHOP, 0);
+	}
+}
+
+// Queue where a third of the pending elements are cancelled in place
+static void gen_cancel(struct gen* g, uint64_t ops)
+{
+	while (g->n < ops)
+	{
+		uint64_t r = rnd() % 100;
+
+		if (g->size < GEN_DEPTH || r < 40)
+			add(g, OP_APPEND);
+		else if (r < 70)
+			emit(g, OP_POP, 0);
+		else if (r < 99)
+			emit(g, OP_EXTRACT, rnd() % g->size);
+		else
+			emit(g, OP_REMOVE_SELECTED, 2 + rnd() % 8);
+	}
+}
+
+static int generate(const char* kind, uint64_t ops, const char* path)
+{
+	static const struct
+	{
+		const char* name;
+		void (*func)(struct gen*, uint64_t);
+	}
+	kinds[] =
+	{
+		{ "fifo", gen_fifo },
+		{ "lifo", gen_lifo },
+		{ "bursty", gen_bursty },
+		{ "cancel", gen_cancel },
+	};
+
+	for (size_t k = 0; k < sizeof(kinds) / sizeof(*kinds); ++k)
+	{
+		if (strcmp(kind, kinds[k].name))
+			continue;
+
+		struct gen g = { fopen(path, "wb"), ring_create(), 0, 0, 0 };
+		uint32_t version = TRACE_VERSION;
+
+		if (!g.f)
+			return perror(path), 1;
+
+		// the record count is patched in at the end
+		fwrite(TRACE_MAGIC, 4, 1, g.f);
+		fwrite(&version, 4, 1, g.f);
+		fwrite(&g.n, 8, 1, g.f);
+
+		kinds[k].func(&g, ops);
+
+		fseek(g.f, 8, SEEK_SET);
+		fwrite(&g.n, 8, 1, g.f);
+		fclose(g.f);
+		ring_destroy(g.sim, NULL);
+
+		printf("%s: %llu records\n", path, (unsigned long long)g.n);
+		return 0;
+	}
+
+	fprintf(stderr, "unknown trace kind %s\n", kind);
+	return 1;
+}
+
+/* ---- Replay --------------------------------------------------------------------- */
+
+#define REPLAY_ARENA_CHUNK 4096
+
+static Ring ring_for(const char* mode)
+{
+	ring_node_cache(strcmp(mode, "nocache") != 0);
+
+	if (!strcmp(mode, "arena") || !strcmp(mode, "huge"))
+	{
+		RingArena a = !strcmp(mode, "arena") ? ring_arena_create(REPLAY_ARENA_CHUNK) :
+			ring_arena_create_huge(REPLAY_ARENA_CHUNK);
+		Ring r = ring_create_in(a);
+
+		ring_arena_destroy(a);
+		return r;
+	}
+
+	return ring_create();
+}
+
+static int cmp_u32(const void* x, const void* y)
+{
+	uint32_t a = *(const uint32_t*)x, b = *(const uint32_t*)y;
+	return (a > b) - (a < b);
+}
+
+static int replay(const char* path, const char* mode)
+{
+	if (strcmp(mode, "heap") && strcmp(mode, "nocache") && strcmp(mode, "arena") && strcmp(mode, "huge"))
+		return fprintf(stderr, "unknown mode %s\n", mode), 1;
+
+	uint64_t n = 0, sum = 0, peak = 0;
+	struct record* trace = trace_load(path, &n);
+
+	if (!trace)
+		return fprintf(stderr, "%s: not a ring trace\n", path), 1;
+
+	uint64_t count[OP_COUNT] = { 0 };
+	uint32_t* lat[OP_COUNT];
+
+	for (uint64_t i = 0; i < n; ++i)
+		count[trace[i].op] += 1;
+
+	// touched now, so that they are part of the baseline
+	for (int op = 0; op < OP_COUNT; ++op)
+	{
+		if (!(lat[op] = malloc(count[op] * sizeof(uint32_t) + 1)))
+			return fprintf(stderr, "out of memory\n"), 1;
+
+		memset(lat[op], 0xff, count[op] * sizeof(uint32_t) + 1);
+	}
+
+	long rss = rss_kib("VmRSS:");
+	peak_reset();
+
+	// throughput, nothing but the operations
+	Ring r = ring_for(mode);
+	double t = now();
+
+	for (uint64_t i = 0; i < n; ++i)
+		sum += apply(r, trace + i);
+
+	t = now() - t;
+	ring_destroy(r, NULL);
+
+	presult("replay: records", "%llu (%s)", (unsigned long long)n, mode);
+	presult("replay: throughput", "%6.2f Mops/s", n / t / 1e6);
+
+	// latency, every operation timed on its own
+	uint64_t at[OP_COUNT] = { 0 };
+	double overhead = now();
+
+	for (int i = 0; i < 1000; ++i)
+		sink += (uint64_t)now();
+
+	overhead = (now() - overhead) / 1000;
+
+	r = ring_for(mode);
+
+	for (uint64_t i = 0; i < n; ++i)
+	{
+		double s = now();
+		sum += apply(r, trace + i);
+		double e = now();
+
+		lat[trace[i].op][at[trace[i].op]++] = (uint32_t)((e - s) * 1e9);
+		peak = ring_size(r) > peak ? ring_size(r) : peak;
+	}
+
+	long peak_rss = rss_kib("VmHWM:");
+
+	ring_destroy(r, NULL);
+	sink = sum;
+
+	for (int op = 0; op < OP_COUNT; ++op)
+	{
+		char name[64];
+
+		if (!count[op])
+			continue;
+
+		qsort(lat[op], count[op], sizeof(uint32_t), cmp_u32);
+
+		snprintf(name, sizeof(name), "replay: %s ns p50/p99/p999/max", op_names[op]);
+		presult(name, "%u / %u / %u / %u",
+			lat[op][count[op] / 2], lat[op][count[op] * 99 / 100],
+			lat[op][count[op] * 999 / 1000], lat[op][count[op] - 1]);
+
+		free(lat[op]);
+	}
+
+	presult("replay: timer overhead", "%6.0f ns (included above)", overhead * 1e9);
+	presult("replay: peak ring size", "%llu", (unsigned long long)peak);
+	presult("replay: peak memory", "%ld KiB above the loaded trace", peak_rss - rss);
+
+	free(trace);
+	return 0;
+}
+
+/* ---- Main ----------------------------------------------------------------------- */
+
+int main(int argc, char** argv)
+{
+	if (argc == 5 && !strcmp(argv[1], "gen"))
+		return generate(argv[2], strtoull(argv[3], NULL, 10), argv[4]);
+
+	if ((argc == 3 || argc == 4) && !strcmp(argv[1], "run"))
+		return replay(argv[2], argc == 4 ? argv[3] : "heap");
+
+	fprintf(stderr,
+		"usage: %s gen <fifo|lifo|bursty|cancel> <ops> <trace>\n"
+		"       %s run <trace> [heap|nocache|arena|huge]\n", argv[0], argv[0]);
+
+	return 1;
+}
@@ -0,0 +1,14 @@
+#!/bin/bash
+
+## Replays a trace against libring: ./replay.sh run <trace> [mode]
+## or writes a synthetic one:        ./replay.sh gen <kind> <ops> <trace>
+
+TARGET="replay"
+SRC="replay.c"
+
+## FLAGS
+CFLAGS="-O2 -std=c99 -pipe -pthread -Winline -Wall -Wextra -Werror -Wno-unused"
+LDLIBS="libring.a -lrt"
+CC="gcc"
+
+make && $CC $CFLAGS -o $TARGET $SRC $LDLIBS && ./$TARGET "$@"
@@ -2,12 +2,25 @@
  * Easy to use single linked list data structure. Fifo and stack usage, as well as concatenation in O(1)
  */
 
+#define _GNU_SOURCE
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 // HEADER
 #include "ring.h"
+#include "ring_intern.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(__x86_64__)
+	#include <immintrin.h>
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -17,453 +30,3801 @@
 	bool ring_check_invariant(Ring r);
 #endif
 
-#ifdef INVARIANT_CHECKS
-	#define perr(format, ...)  fprintf(stderr, "ERROR " format "\n", ## __VA_ARGS__)
-	#define EXIT_FAILURE_ASSERT 110
-	#define ASSERT(x, ...) \
-		if (!(x)) \
-		{\
-			perr("ASSERT FAILED: " #__VA_ARGS__ " (" #x ")   File: " \
-			__FILE__ "   Line: %d", __LINE__); \
-			exit(EXIT_FAILURE_ASSERT); \
-		}
+// USDT probes of provider libring, a nop per call site unless a tracer
+// attaches. Built in whenever <sys/sdt.h> is there, -DRING_NO_USDT drops them.
+#if !defined(RING_NO_USDT) && defined(__has_include)
+	#if __has_include(<sys/sdt.h>)
+		#include <sys/sdt.h>
+		#define RING_USDT
+	#endif
+#endif
+
+#ifdef RING_USDT
+	#define PROBE(name, ...) STAP_PROBEV(libring, name, __VA_ARGS__)
 #else
-	#define ASSERT(x, ...)
+	#define PROBE(name, ...)
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 // FUNCTIONS INTERN
 
+#ifdef RING_SOJOURN
+// -----------------------------------------------------------------------------
 /**
- * Safe malloc. TODO implement user defind allocation function. 
+ * Monotonic time in ns.
  */
-static inline void* _smalloc(uint64_t s)
+static inline uint64_t _ring_now(void)
 {
-	void * res = malloc(s);
-	if (!res)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000UL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// NODE CACHE
+
+// nodes per magazine
+#define RING_MAG_NODES 64
+// full magazines kept in the depot, further ones go back to malloc
+#define RING_DEPOT_MAGS 256
+
+// Magazines of one thread, nodes linked by next. spare is empty or full.
+struct _RingMags
+{
+	struct _Node* loaded;
+	uint32_t loaded_n;
+	struct _Node* spare;
+	uint32_t spare_n;
+	bool registered;
+};
+
+static __thread struct _RingMags _ring_mags;
+
+static bool _ring_cache_on = true;
+
+// full magazines shared by all threads, linked by the contend of their first node
+static struct _Node* _ring_depot;
+static uint64_t _ring_depot_n;
+static pthread_mutex_t _ring_depot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// flushes the magazines of exiting threads
+static pthread_key_t _ring_mags_key;
+static pthread_once_t _ring_mags_once = PTHREAD_ONCE_INIT;
+
+// -----------------------------------------------------------------------------
+/**
+ * Frees a chain of nodes. 
+ */
+static void _mag_free(struct _Node* n)
+{
+	while (n != NULL)
+	{
+		struct _Node* delme = n;
+
+		n = n->next;
+		free(delme);
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Hands a magazine of n nodes to the depot. Partial magazines and the ones
+ * beyond RING_DEPOT_MAGS are freed.
+ */
+static void _depot_put(struct _Node* mag, uint32_t n)
+{
+	if (n == RING_MAG_NODES)
+	{
+		pthread_mutex_lock(&_ring_depot_lock);
+
+		if (_ring_depot_n < RING_DEPOT_MAGS)
+		{
+			mag->contend = _ring_depot;
+			_ring_depot = mag;
+			_ring_depot_n += 1;
+			mag = NULL;
+		}
+
+		pthread_mutex_unlock(&_ring_depot_lock);
+	}
+
+	_mag_free(mag);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Loads a full magazine from the depot into m. false if the depot is empty.
+ */
+static bool _depot_get(struct _RingMags* m)
+{
+	pthread_mutex_lock(&_ring_depot_lock);
+
+	struct _Node* mag = _ring_depot;
+
+	if (mag)
+	{
+		_ring_depot = mag->contend;
+		_ring_depot_n -= 1;
+	}
+
+	pthread_mutex_unlock(&_ring_depot_lock);
+
+	if (!mag)
+		return false;
+
+	m->loaded = mag;
+	m->loaded_n = RING_MAG_NODES;
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Gives both magazines of a thread away, also called at thread exit.
+ */
+static void _mags_flush(void* p)
+{
+	struct _RingMags* m = p;
+
+	_depot_put(m->loaded, m->loaded_n);
+	_depot_put(m->spare, m->spare_n);
+
+	m->loaded = NULL;
+	m->loaded_n = 0;
+	m->spare = NULL;
+	m->spare_n = 0;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Key destructors don't run for the thread that returns from main, the
+ * magazines of that one and the depot are released at exit.
+ */
+static void _ring_cache_exit(void)
+{
+	ring_node_cache_trim();
+}
+
+static void _mags_key_create(void)
+{
+	if (pthread_key_create(&_ring_mags_key, _mags_flush) || atexit(_ring_cache_exit))
 		abort();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Arranges the flush of the magazines at the exit of the calling thread.
+ */
+static void _mags_register(struct _RingMags* m)
+{
+	pthread_once(&_ring_mags_once, _mags_key_create);
+	pthread_setspecific(_ring_mags_key, m);
+	m->registered = true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Refills the loaded magazine from the spare one or the depot, falls back
+ * to malloc.
+ */
+static __attribute__((noinline)) struct _Node* _node_alloc_slow(struct _RingMags* m)
+{
+	if (!__atomic_load_n(&_ring_cache_on, __ATOMIC_RELAXED))
+		return _smalloc(sizeof(struct _Node));
+
+	if (!m->registered)
+		_mags_register(m);
+
+	if (m->spare_n)
+	{
+		m->loaded = m->spare;
+		m->loaded_n = m->spare_n;
+		m->spare = NULL;
+		m->spare_n = 0;
+	}
+	else if (!_depot_get(m))
+	{
+		return _smalloc(sizeof(struct _Node));
+	}
+
+	struct _Node* res = m->loaded;
+
+	m->loaded = res->next;
+	m->loaded_n -= 1;
+
 	return res;
 }
 
 // -----------------------------------------------------------------------------
 /**
- * Creates a new Node. 
+ * Allocates a heap node, from the magazines of the thread if possible.
  */
-static inline struct _Node* _ring_create_node(struct _Node* n, cp c)
+static inline struct _Node* _node_alloc(void)
 {
-	struct _Node* res = _smalloc(sizeof(*res));
-	res->next = n;
-	res->contend = c;
+	struct _RingMags* m = &_ring_mags;
+
+	if (!m->loaded_n)
+		return _node_alloc_slow(m);
+
+	struct _Node* res = m->loaded;
+
+	m->loaded = res->next;
+	m->loaded_n -= 1;
+
 	return res;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ * Makes room in the loaded magazine, the full one becomes the spare and
+ * the old spare goes to the depot.
+ */
+static __attribute__((noinline)) void _node_free_slow(struct _RingMags* m, struct _Node* n)
+{
+	if (!__atomic_load_n(&_ring_cache_on, __ATOMIC_RELAXED))
+	{
+		free(n);
+		return;
+	}
+
+	if (!m->registered)
+		_mags_register(m);
+
+	if (m->loaded_n == RING_MAG_NODES)
+	{
+		if (m->spare_n)
+			_depot_put(m->spare, m->spare_n);
+
+		m->spare = m->loaded;
+		m->spare_n = m->loaded_n;
+		m->loaded = NULL;
+		m->loaded_n = 0;
+	}
+
+	n->next = m->loaded;
+	m->loaded = n;
+	m->loaded_n += 1;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Releases a heap node into the magazines of the thread. Every node is a
+ * malloc block of its own, so free() stays valid for it as well.
+ */
+static inline void _node_free(struct _Node* n)
+{
+	struct _RingMags* m = &_ring_mags;
 
+	if (!m->registered || m->loaded_n == RING_MAG_NODES ||
+		!__atomic_load_n(&_ring_cache_on, __ATOMIC_RELAXED))
+	{
+		_node_free_slow(m, n);
+		return;
+	}
+
+	n->next = m->loaded;
+	m->loaded = n;
+	m->loaded_n += 1;
+}
 
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-// EXTERN INTERFACE FUNCTIONS
+// ARENA
+
+#define RING_ARENA_CHUNK_NODES 4096
+
+// chunks of huge page arenas are multiples of this
+#define RING_HUGE_PAGE (2UL << 20)
+// and the ones of other mapped chunks of this
+#define RING_PAGE 4096UL
+
+// NUMA nodes a policy mask covers
+#define RING_NUMA_NODES 1024
+
+// memory policy constants of <numaif.h>, no libnuma needed for the syscalls
+#define RING_MPOL_PREFERRED 1
+#define RING_MPOL_F_NODE 1
+#define RING_MPOL_F_ADDR 2
+#define RING_MPOL_F_MEMS_ALLOWED 4
+
+// One block of nodes
+struct _RingChunk
+{
+	struct _Node* base;
+	uint64_t n;
+	// mmap'd instead of malloc'd
+	bool mapped;
+};
+
+// Chunk table of a merged arena, joins the sorted table on the next lookup
+struct _RingChunkTable
+{
+	struct _RingChunk* chunks;
+	uint64_t len;
+	struct _RingChunkTable* next;
+};
+
+struct _RingArena
+{
+	// rings using the arena plus the handle of the creator
+	uint64_t refs;
+	// set once the arena got merged into another arena
+	struct _RingArena* merged;
+	// chunk size for the free list refill
+	uint64_t chunk_nodes;
+	// free nodes, linked by next. free_last is valid while free isn't NULL
+	struct _Node* free;
+	struct _Node* free_last;
+	// chunks sorted by base address
+	struct _RingChunk* chunks;
+	uint64_t chunks_len;
+	uint64_t chunks_cap;
+	// tables of merged arenas, see _arena_settle. pending_last is valid
+	// while pending isn't NULL
+	struct _RingChunkTable* pending;
+	struct _RingChunkTable* pending_last;
+	// rings of this arena may hold malloc'd nodes (see _ring_adopt)
+	bool foreign;
+	// chunks come from huge pages, see ring_arena_create_huge
+	bool huge;
+	// NUMA node the chunks are placed on, -1 -> wherever the kernel likes
+	int numa;
+};
 
 // -----------------------------------------------------------------------------
 /**
- * Create a new Ring.
- * Complexity always O(1)
+ * Creates an arena with one reference.
  */
-Ring ring_create(void)
+static struct _RingArena* _arena_new(uint64_t chunk_nodes)
 {
-	Ring res = _smalloc(sizeof(*res));
+	struct _RingArena* a = _smalloc(sizeof(*a));
+
+	a->refs = 1;
+	a->merged = NULL;
+	a->chunk_nodes = chunk_nodes ? chunk_nodes : RING_ARENA_CHUNK_NODES;
+	a->free = NULL;
+	a->free_last = NULL;
+	a->chunks = NULL;
+	a->chunks_len = 0;
+	a->chunks_cap = 0;
+	a->pending = NULL;
+	a->pending_last = NULL;
+	a->foreign = false;
+	a->huge = false;
+	a->numa = -1;
+
+	return a;
+}
 
-	res->size = 0;
-	res->first = NULL;
-	res->last = NULL;
+// -----------------------------------------------------------------------------
+/**
+ * Maps at least *n nodes, *n is rounded up to the mapping. On huge pages if
+ * huge: explicit ones first, then transparent ones on an aligned mapping.
+ * NULL if mmap fails.
+ */
+static struct _Node* _chunk_map(uint64_t* n, bool huge)
+{
+	size_t align = huge ? RING_HUGE_PAGE : RING_PAGE;
+	size_t bytes = (*n * sizeof(struct _Node) + align - 1) & ~(align - 1);
+	char* p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	if (huge)
+		p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
 
-	ASSERT(ring_check_invariant(res));
+	if (!huge)
+	{
+		p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-	return res;	
+		if (p == MAP_FAILED)
+			return NULL;
+	}
+	else if (p == MAP_FAILED)
+	{
+		// one huge page more to cut an aligned window out of it
+		char* raw = mmap(NULL, bytes + RING_HUGE_PAGE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (raw == MAP_FAILED)
+			return NULL;
+
+		p = (char*)(((uintptr_t)raw + RING_HUGE_PAGE - 1) & ~(RING_HUGE_PAGE - 1));
+
+		if (p > raw)
+			munmap(raw, p - raw);
+
+		if (p + bytes < raw + bytes + RING_HUGE_PAGE)
+			munmap(p + bytes, raw + RING_HUGE_PAGE - p);
+
+#ifdef MADV_HUGEPAGE
+		madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+	}
+
+	*n = bytes / sizeof(struct _Node);
+
+	return (struct _Node*)p;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ * True if the calling thread may place memory on NUMA node.
+ */
+static bool _numa_allowed(int node)
+{
+	unsigned long mask[RING_NUMA_NODES / (8 * sizeof(unsigned long))] = { 0 };
+	unsigned long bits = 8 * sizeof(unsigned long);
+
+	if (node < 0 || node >= RING_NUMA_NODES)
+		return false;
+
+	if (syscall(SYS_get_mempolicy, NULL, mask, RING_NUMA_NODES, NULL, RING_MPOL_F_MEMS_ALLOWED))
+		return false;
+
+	return mask[node / bits] >> (node % bits) & 1;
+}
 
 // -----------------------------------------------------------------------------
 /**
- * Destroys a Ring. All memory is released.
- * Complexity always O(n)
+ * Asks for the pages of a fresh mapping on NUMA node. Preferred, not bound:
+ * a full node falls back to another one instead of failing the allocation.
  */
-void ring_destroy(Ring r, void(*free_contend)(cp))
+static void _chunk_bind(void* p, size_t bytes, int node)
 {
-	ASSERT(ring_check_invariant(r));
+	unsigned long mask[RING_NUMA_NODES / (8 * sizeof(unsigned long))] = { 0 };
+	unsigned long bits = 8 * sizeof(unsigned long);
 
-	struct _Node* tmp; 
-		
-	while(r->first != NULL)
+	mask[node / bits] = 1UL << (node % bits);
+
+	syscall(SYS_mbind, p, bytes, RING_MPOL_PREFERRED, mask, RING_NUMA_NODES, 0);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Gives the memory of a chunk back. 
+ */
+static void _chunk_release(struct _RingChunk* c)
+{
+	if (c->mapped)
+		munmap(c->base, c->n * sizeof(struct _Node));
+	else
+		free(c->base);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Drops one reference, releases the arena with the last one.
+ */
+static void _arena_unref(struct _RingArena* a)
+{
+	if (--a->refs)
+		return;
+
+	if (a->merged)
+		_arena_unref(a->merged);
+
+	for (struct _RingChunkTable* t = a->pending; t != NULL; )
 	{
-		tmp = r->first;
-		r->first = r->first->next;
+		struct _RingChunkTable* next = t->next;
 
-		if(free_contend)
-			free_contend(tmp->contend);
+		for (uint64_t i = 0; i < t->len; ++i)
+			_chunk_release(t->chunks + i);
 
-		free(tmp);
+		free(t->chunks);
+		free(t);
+		t = next;
 	}
 
-	free(r);
-	r = NULL;
+	for (uint64_t i = 0; i < a->chunks_len; ++i)
+		_chunk_release(a->chunks + i);
 
+	free(a->chunks);
+	free(a);
 }
 
+// -----------------------------------------------------------------------------
+/**
+ * Follows the merge chain of the ring arena and short-cuts it.
+ */
+static void _ring_arena_forward(Ring r)
+{
+	struct _RingArena* a = r->arena;
+
+	while (a->merged)
+		a = a->merged;
+
+	a->refs += 1;
+	_arena_unref(r->arena);
+	r->arena = a;
+}
 
 // -----------------------------------------------------------------------------
 /**
- * Adds one element at the beginning of the ring.
- * Complexity always O(1)
+ * The current arena of a ring. NULL for heap rings.
  */
-void ring_push(Ring r, cp c)
+static inline struct _RingArena* _ring_arena(Ring r)
 {
-	ASSERT(ring_check_invariant(r));
+	if (r->arena && r->arena->merged)
+		_ring_arena_forward(r);
 
-	r->first = _ring_create_node(r->first, c);
+	return r->arena;
+}
 
-	if (ring_is_empty(r))
-		r->last = r->first;
+// -----------------------------------------------------------------------------
+/**
+ * Merges the chunk tables of merged arenas into the sorted one.
+ * Complexity O(chunks) per pending table
+ */
+static __attribute__((noinline)) void _arena_settle(struct _RingArena* a)
+{
+	while (a->pending)
+	{
+		struct _RingChunkTable* t = a->pending;
 
-	r->size += 1;
+		if (a->chunks_len + t->len > a->chunks_cap)
+		{
+			a->chunks_cap = a->chunks_len + t->len;
+			a->chunks = _srealloc(a->chunks, a->chunks_cap * sizeof(*a->chunks));
+		}
 
-	ASSERT(ring_check_invariant(r));
+		// merge both sorted tables from the back
+		uint64_t i = a->chunks_len;
+		uint64_t j = t->len;
+		uint64_t k = i + j;
+
+		while (j > 0)
+		{
+			if (i > 0 && a->chunks[i - 1].base > t->chunks[j - 1].base)
+				a->chunks[--k] = a->chunks[--i];
+			else
+				a->chunks[--k] = t->chunks[--j];
+		}
+
+		a->chunks_len += t->len;
+		a->pending = t->next;
+
+		free(t->chunks);
+		free(t);
+	}
 }
 
+// -----------------------------------------------------------------------------
+/**
+ * Index of the chunk that contains node n. chunks_len if there is none.
+ */
+static uint64_t _arena_find(struct _RingArena* a, struct _Node* n)
+{
+	if (a->pending)
+		_arena_settle(a);
+
+	uint64_t lo = 0;
+	uint64_t hi = a->chunks_len;
+
+	while (lo < hi)
+	{
+		uint64_t mid = lo + (hi - lo) / 2;
+
+		if (n < a->chunks[mid].base)
+			hi = mid;
+		else if (n >= a->chunks[mid].base + a->chunks[mid].n)
+			lo = mid + 1;
+		else
+			return mid;
+	}
+
+	return a->chunks_len;
+}
 
 // -----------------------------------------------------------------------------
 /**
- * Adds one element at the end of the ring.
- * Complexity always O(1)
+ * Puts the linked nodes first to last in front of the free list.
  */
-void ring_append(Ring r, cp c)
+static inline void _arena_free_chain(struct _RingArena* a, struct _Node* first, struct _Node* last)
 {
-	ASSERT(ring_check_invariant(r));
+	last->next = a->free;
 
-	struct _Node* tmp = _ring_create_node(NULL, c);
+	if (!a->free)
+		a->free_last = last;
 
-	if (ring_is_empty(r))
-		r->first = tmp;
-	else
-		r->last->next = tmp;
+	a->free = first;
+}
 
-	r->last = tmp;
+// -----------------------------------------------------------------------------
+/**
+ * Adds a chunk of n nodes. The nodes are not linked into the free list,
+ * except the ones a mapped chunk has on top of n.
+ */
+static struct _Node* _arena_chunk(struct _RingArena* a, uint64_t n)
+{
+	uint64_t len = n;
+	struct _Node* base = a->huge || a->numa >= 0 ? _chunk_map(&len, a->huge) : NULL;
+	bool mapped = base != NULL;
+	uint64_t pos = a->chunks_len;
+
+	if (!base)
+	{
+		// no huge pages today, plain memory
+		base = _smalloc(n * sizeof(*base));
+		len = n;
+	}
+	else if (a->numa >= 0)
+	{
+		// before the first touch, that is when the pages are placed
+		_chunk_bind(base, len * sizeof(*base), a->numa);
+	}
+
+	for (uint64_t i = n; i < len; ++i)
+		_arena_free_chain(a, base + i, base + i);
+
+	if (a->chunks_len == a->chunks_cap)
+	{
+		a->chunks_cap = a->chunks_cap ? a->chunks_cap * 2 : 8;
+		a->chunks = _srealloc(a->chunks, a->chunks_cap * sizeof(*a->chunks));
+	}
+
+	while (pos > 0 && a->chunks[pos - 1].base > base)
+	{
+		a->chunks[pos] = a->chunks[pos - 1];
+		--pos;
+	}
+
+	a->chunks[pos].base = base;
+	a->chunks[pos].n = len;
+	a->chunks[pos].mapped = mapped;
+	a->chunks_len += 1;
+
+	return base;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Puts a new chunk on the free list.
+ */
+static void _arena_refill(struct _RingArena* a)
+{
+	struct _Node* base = _arena_chunk(a, a->chunk_nodes);
+
+	for (uint64_t i = 0; i + 1 < a->chunk_nodes; ++i)
+		base[i].next = base + i + 1;
+
+	_arena_free_chain(a, base, base + a->chunk_nodes - 1);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Takes a node from the free list, refills it with a new chunk if needed.
+ */
+static inline struct _Node* _arena_get(struct _RingArena* a)
+{
+	if (!a->free)
+		_arena_refill(a);
+
+	struct _Node* res = a->free;
+	a->free = res->next;
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Gives a node back. Foreign heap nodes go back to malloc.
+ */
+static inline void _arena_put(struct _RingArena* a, struct _Node* n)
+{
+	if (a->foreign && _arena_find(a, n) == a->chunks_len)
+	{
+		_node_free(n);
+		return;
+	}
+
+	_arena_free_chain(a, n, n);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves chunks and free list of b into a. The chunk tables of b join the
+ * pending ones of a, they are merged on the next lookup. b stays as forward
+ * stub for the rings still pointing to it.
+ * Complexity always O(1)
+ */
+static void _arena_merge(struct _RingArena* a, struct _RingArena* b)
+{
+	if (b->chunks_len)
+	{
+		struct _RingChunkTable* t = _smalloc(sizeof(*t));
+
+		t->chunks = b->chunks;
+		t->len = b->chunks_len;
+		t->next = b->pending;
+
+		if (!b->pending)
+			b->pending_last = t;
+
+		b->pending = t;
+	}
+	else
+	{
+		free(b->chunks);
+	}
+
+	if (b->pending)
+	{
+		b->pending_last->next = a->pending;
+
+		if (!a->pending)
+			a->pending_last = b->pending_last;
+
+		a->pending = b->pending;
+	}
+
+	if (b->free)
+		_arena_free_chain(a, b->free, b->free_last);
+
+	a->foreign |= b->foreign;
+
+	b->chunks = NULL;
+	b->chunks_len = 0;
+	b->chunks_cap = 0;
+	b->pending = NULL;
+	b->free = NULL;
+
+	b->merged = a;
+	a->refs += 1;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Nodes of src are about to move into dst. Both rings end up with the same
+ * arena afterwards, or both are heap rings.
+ */
+static void _ring_adopt(Ring dst, Ring src)
+{
+	struct _RingArena* a = _ring_arena(dst);
+	struct _RingArena* b = _ring_arena(src);
+
+	if (a == b)
+		return;
+
+	if (!b)
+	{
+		if (!ring_is_empty(src))
+			a->foreign = true;
+	}
+	else if (!a)
+	{
+		if (!ring_is_empty(dst))
+			b->foreign = true;
+
+		b->refs += 1;
+		dst->arena = b;
+	}
+	else
+	{
+		_arena_merge(a, b);
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies the live elements of r in list order into block, which has room
+ * for ring_size(r) nodes, and makes it the chain of r. The old nodes go back
+ * to the arena from, or to malloc if from is NULL.
+ */
+static void _ring_move_nodes(Ring r, struct _Node* block, struct _RingArena* from)
+{
+	struct _Node* step = r->first;
+
+	for (uint64_t i = 0; step != NULL; )
+	{
+		struct _Node* old = step;
+
+		step = step->next;
+
+		if (old->contend != RING_TOMBSTONE)
+		{
+			block[i].contend = old->contend;
+			block[i].next = block + i + 1;
+#ifdef RING_SOJOURN
+			block[i].enq = old->enq;
+#endif
+			i += 1;
+		}
+
+		if (from)
+			_arena_put(from, old);
+		else
+			_node_free(old);
+	}
+
+	block[ring_size(r) - 1].next = NULL;
+
+	r->first = block;
+	r->last = block + ring_size(r) - 1;
+	r->dead = 0;
+	r->sweeping = false;
+	r->sweep = NULL;
+	r->finger = NULL;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// NODES
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new Node. 
+ */
+static inline struct _Node* _ring_create_node(Ring r, struct _Node* n, cp c)
+{
+	struct _RingArena* a = _ring_arena(r);
+	struct _Node* res = a ? _arena_get(a) : _node_alloc();
+	res->next = n;
+	res->contend = c;
+#ifdef RING_SOJOURN
+	// 0 is no stamp, see _sojourn_note
+	res->enq = r->sojourn ? _ring_now() | 1 : 0;
+#endif
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Gives the memory of a Node of the ring r back. 
+ */
+static inline void _ring_release_node(Ring r, struct _Node* n)
+{
+	struct _RingArena* a = _ring_arena(r);
+
+	if (a)
+		_arena_put(a, n);
+	else
+		_node_free(n);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// CONCURRENT MODE
+
+// retired nodes before the writer tries to advance the epoch
+#define RING_RCU_BATCH 64
+
+// one reader slot per cache line
+struct _RingRcuSlot
+{
+	// announced epoch, 0 if the slot is free
+	uint64_t epoch;
+	char pad[56];
+};
+
+struct _RingRcu
+{
+	// global epoch, starts at 1. Only the writer changes it
+	uint64_t epoch;
+	// seqlock over first and size, odd while the writer is busy
+	uint64_t seq;
+	uint32_t readers;
+	struct _RingRcuSlot* slots;
+	// nodes retired in the last three epochs
+	struct _Node** limbo[3];
+	uint64_t limbo_len[3];
+	uint64_t limbo_cap[3];
+};
+
+// -----------------------------------------------------------------------------
+/**
+ * Writer enters an operation readers must not see half done.
+ */
+static inline void _ring_seq_begin(Ring r)
+{
+	if (!r->rcu)
+		return;
+
+	__atomic_store_n(&r->rcu->seq, r->rcu->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Writer leaves the operation.
+ */
+static inline void _ring_seq_end(Ring r)
+{
+	if (!r->rcu)
+		return;
+
+	__atomic_store_n(&r->rcu->seq, r->rcu->seq + 1, __ATOMIC_RELEASE);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Frees the nodes of one limbo list.
+ */
+static void _rcu_flush(Ring r, uint32_t i)
+{
+	struct _RingRcu* rcu = r->rcu;
+
+	for (uint64_t k = 0; k < rcu->limbo_len[i]; ++k)
+		_ring_release_node(r, rcu->limbo[i][k]);
+
+	rcu->limbo_len[i] = 0;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves to the next epoch if every active reader has seen the current one.
+ * The nodes retired two epochs ago are unreachable then.
+ */
+static bool _rcu_advance(Ring r)
+{
+	struct _RingRcu* rcu = r->rcu;
+
+	// orders the unlinking of the retired nodes before the slot scan
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	for (uint32_t i = 0; i < rcu->readers; ++i)
+	{
+		uint64_t e = __atomic_load_n(&rcu->slots[i].epoch, __ATOMIC_ACQUIRE);
+
+		if (e && e != rcu->epoch)
+			return false;
+	}
+
+	__atomic_store_n(&rcu->epoch, rcu->epoch + 1, __ATOMIC_SEQ_CST);
+	_rcu_flush(r, (rcu->epoch + 1) % 3);
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Defers the release of a node until no snapshot can reach it.
+ */
+static void _rcu_retire(Ring r, struct _Node* n)
+{
+	struct _RingRcu* rcu = r->rcu;
+	uint32_t i = rcu->epoch % 3;
+
+	if (rcu->limbo_len[i] == rcu->limbo_cap[i])
+	{
+		rcu->limbo_cap[i] = rcu->limbo_cap[i] ? rcu->limbo_cap[i] * 2 : RING_RCU_BATCH;
+		rcu->limbo[i] = _srealloc(rcu->limbo[i], rcu->limbo_cap[i] * sizeof(*rcu->limbo[i]));
+	}
+
+	rcu->limbo[i][rcu->limbo_len[i]++] = n;
+
+	if (rcu->limbo_len[i] % RING_RCU_BATCH == 0)
+		_rcu_advance(r);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Leaves concurrent mode, no reader may be active anymore.
+ */
+static void _rcu_disable(Ring r)
+{
+	struct _RingRcu* rcu = r->rcu;
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		_rcu_flush(r, i);
+		free(rcu->limbo[i]);
+	}
+
+	free(rcu->slots);
+	free(rcu);
+	r->rcu = NULL;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Releases a Node of the ring r. 
+ */
+static void _ring_free_node(Ring r, struct _Node* n)
+{
+	// an incremental compaction restarts at the first node
+	if (n == r->sweep)
+		r->sweep = NULL;
+
+	if (n == r->finger)
+		r->finger = NULL;
+
+	if (r->rcu)
+		_rcu_retire(r, n);
+	else
+		_ring_release_node(r, n);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Releases the base structure of a ring, the nodes are gone already. 
+ */
+static inline void _ring_free_base(Ring r)
+{
+	if (r->rcu)
+		_rcu_disable(r);
+
+	if (r->arena)
+		_arena_unref(r->arena);
+
+	free(r->bound);
+	free(r->sojourn);
+	free(r);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TOMBSTONES
+
+// Only the address matters, see RING_TOMBSTONE
+char _ring_tombstone_mark;
+
+#define RING_DEAD_PERCENT 50
+
+// -----------------------------------------------------------------------------
+/**
+ * Unlinks up to budget tombstones, continuing where the last call stopped.
+ * The first node is never a tombstone, so a pass always has a predecessor.
+ */
+static void _ring_sweep(Ring r, uint64_t budget)
+{
+	struct _Node* s = r->sweep ? r->sweep : r->first;
+
+	for (; budget && s != NULL && s->next != NULL && r->dead; --budget)
+	{
+		struct _Node* n = s->next;
+
+		if (n->contend != RING_TOMBSTONE)
+		{
+			s = n;
+			continue;
+		}
+
+		s->next = n->next;
+
+		if (n == r->last)
+			r->last = s;
+
+		r->dead -= 1;
+
+		_ring_free_node(r, n);
+	}
+
+	if (s == NULL || s->next == NULL || !r->dead)
+	{
+		r->sweeping = false;
+		r->sweep = NULL;
+	}
+	else
+	{
+		r->sweep = s;
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Unlinks all tombstones. 
+ */
+static void _ring_purge(Ring r)
+{
+	r->sweep = NULL;
+
+	_ring_sweep(r, UINT64_MAX);
+
+	ASSERT(!r->dead);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Frees the tombstones at the head of the ring, after a pop. 
+ */
+static inline void _ring_skip_dead(Ring r)
+{
+	while (r->first != NULL && r->first->contend == RING_TOMBSTONE)
+	{
+		struct _Node* delme = r->first;
+
+		r->first = r->first->next;
+		r->dead -= 1;
+
+		_ring_free_node(r, delme);
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Live node at position i < ring_size(r). *prev receives the node before
+ * it in the chain (NULL for the first one), *dead the number of tombstones
+ * in front of it.
+ */
+static struct _Node* _ring_locate(Ring r, uint64_t i, struct _Node** prev, uint64_t* dead)
+{
+	struct _Node* p = NULL;
+	struct _Node* n = r->first;
+	uint64_t d = 0;
+
+	if (!r->dead)
+	{
+		for (; i > 0; --i)
+		{
+			p = n;
+			n = n->next;
+		}
+	}
+	else
+	{
+		for (;;)
+		{
+			if (n->contend == RING_TOMBSTONE)
+				d += 1;
+			else if (!i--)
+				break;
+
+			p = n;
+			n = n->next;
+		}
+	}
+
+	*prev = p;
+	*dead = d;
+
+	return n;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Live nodes _ring_seek(r, i, prev) walks over, for the probes.
+ */
+static inline uint64_t _ring_walk(Ring r, uint64_t i, bool prev)
+{
+	// handled by pop/push/append or out of bounds
+	if (i == 0 || i >= ring_size(r))
+		return 0;
+
+	if (r->finger && (r->finger_pos < i || (!prev && r->finger_pos == i)))
+		return i - r->finger_pos;
+
+	return i;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Live node at position i < ring_size(r), starting at the finger if it is
+ * in front of i. With prev != NULL *prev receives the node before it in the
+ * chain, i > 0 in that case. The finger is left on the result.
+ */
+static struct _Node* _ring_seek(Ring r, uint64_t i, struct _Node** prev)
+{
+	struct _Node* p = NULL;
+	struct _Node* n = r->first;
+	uint64_t pos = 0;
+
+	// with prev the finger has to be passed to know the predecessor
+	if (r->finger && (r->finger_pos < i || (!prev && r->finger_pos == i)))
+	{
+		n = r->finger;
+		pos = r->finger_pos;
+	}
+
+	for (;;)
+	{
+		if (n->contend != RING_TOMBSTONE)
+		{
+			if (pos == i)
+				break;
+
+			pos += 1;
+		}
+
+		p = n;
+		n = n->next;
+	}
+
+	if (prev)
+		*prev = p;
+
+	r->finger = n;
+	r->finger_pos = i;
+
+	return n;
+}
+
+
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the first element of the non empty ring r.
+ */
+static inline cp _ring_pop_first(Ring r)
+{
+	cp res = r->first->contend;
+
+	struct _Node * delme = r->first;
+
+	_ring_seq_begin(r);
+	
+	r->first = r->first->next;
+
+	if(ring_size(r) == 1 && !r->dead)
+		r->last = NULL;
+
+	r->size -= 1;
+	r->finger_pos -= 1;
+
+	_ring_seq_end(r);
+	
+	_ring_free_node(r, delme);
+
+	if (r->dead)
+	{
+		_ring_skip_dead(r);
+
+		if (r->first == NULL)
+			r->last = NULL;
+	}
+
+	if (r->sweeping)
+		_ring_sweep(r, r->sweep_budget);
+
+	return res;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// BOUNDED RINGS
+
+struct _RingBound
+{
+	uint64_t cap;
+	enum RingPolicy policy;
+	// receives dropped elements, may be NULL
+	void(*dropped)(cp c, void* ud);
+	void* ud;
+	uint64_t drops;
+	uint64_t rejects;
+};
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the first element outside of ring_pop, see SOJOURN TIME.
+ */
+static inline cp _ring_take_first(Ring r);
+
+// -----------------------------------------------------------------------------
+/**
+ * True if one more element fits into r. Applies the policy of a full ring.
+ */
+static inline bool _ring_room(Ring r)
+{
+	struct _RingBound* b = r->bound;
+
+	if (!b || ring_size(r) < b->cap)
+		return true;
+
+	if (b->policy != RING_DROP_OLDEST)
+	{
+		b->rejects += 1;
+		return false;
+	}
+
+	cp c = _ring_take_first(r);
+
+	b->drops += 1;
+
+	if (b->dropped)
+		b->dropped(c, b->ud);
+
+	return true;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// SOJOURN TIME
+
+struct _RingSojourn
+{
+	uint64_t hist[RING_SOJOURN_BUCKETS];
+	// CoDel, target 0 -> off
+	uint64_t target;
+	uint64_t interval;
+	// time the sojourn went above target plus interval, 0 -> below target
+	uint64_t first_above;
+	// time of the next drop while dropping
+	uint64_t drop_next;
+	uint32_t count;
+	uint32_t lastcount;
+	bool dropping;
+	uint64_t drops;
+	// receives dropped elements, may be NULL
+	void(*dropped)(cp c, void* ud);
+	void* ud;
+};
+
+#ifdef RING_SOJOURN
+// -----------------------------------------------------------------------------
+/**
+ * Sojourn time of the first element of r, counted in the histogram. Nodes
+ * without a stamp (enq 0) are not counted.
+ */
+static inline uint64_t _sojourn_note(Ring r, uint64_t now)
+{
+	if (!r->first->enq)
+		return 0;
+
+	uint64_t t = now > r->first->enq ? now - r->first->enq : 0;
+
+	r->sojourn->hist[t ? 63 - __builtin_clzll(t) : 0] += 1;
+
+	return t;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Integer square root, for the CoDel control law.
+ */
+static uint32_t _ring_isqrt(uint32_t x)
+{
+	uint32_t res = 0;
+
+	for (uint32_t bit = 1U << 30; bit; bit >>= 2)
+	{
+		if (x >= res + bit)
+		{
+			x -= res + bit;
+			res = (res >> 1) + bit;
+		}
+		else
+		{
+			res >>= 1;
+		}
+	}
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Next drop time, interval / sqrt(count) after t.
+ */
+static inline uint64_t _codel_control(struct _RingSojourn* s, uint64_t t)
+{
+	return t + s->interval / _ring_isqrt(s->count ? s->count : 1);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Pops the first element of the non empty ring r and accounts its sojourn
+ * time. *ok_to_drop tells if the sojourn has been above target for at
+ * least one interval. Elements without a stamp leave the state alone.
+ */
+static cp _sojourn_dequeue(Ring r, uint64_t now, bool* ok_to_drop)
+{
+	struct _RingSojourn* s = r->sojourn;
+
+	*ok_to_drop = false;
+
+	if (!r->first->enq)
+		return _ring_pop_first(r);
+
+	uint64_t t = _sojourn_note(r, now);
+	cp res = _ring_pop_first(r);
+
+	if (t < s->target || ring_is_empty(r))
+		s->first_above = 0;
+	else if (!s->first_above)
+		s->first_above = now + s->interval;
+	else if (now >= s->first_above)
+		*ok_to_drop = true;
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Hands an element dropped by CoDel over.
+ */
+static inline void _codel_drop(struct _RingSojourn* s, cp c)
+{
+	s->drops += 1;
+
+	if (s->dropped)
+		s->dropped(c, s->ud);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * ring_pop of a ring with sojourn tracking, the CoDel dequeue of RFC 8289.
+ */
+static __attribute__((noinline)) cp _sojourn_pop(Ring r)
+{
+	struct _RingSojourn* s = r->sojourn;
+
+	// added before the tracking started, its sojourn is unknown
+	if (!r->first->enq)
+		return _ring_pop_first(r);
+
+	uint64_t now = _ring_now();
+	bool ok;
+	cp res = _sojourn_dequeue(r, now, &ok);
+
+	if (!s->target)
+		return res;
+
+	if (s->dropping)
+	{
+		if (!ok)
+			s->dropping = false;
+
+		while (s->dropping && now >= s->drop_next)
+		{
+			_codel_drop(s, res);
+			s->count += 1;
+
+			if (ring_is_empty(r))
+			{
+				s->dropping = false;
+				return NULL;
+			}
+
+			// not judged, the next pop goes on dropping
+			if (!r->first->enq)
+				return _ring_pop_first(r);
+
+			res = _sojourn_dequeue(r, now, &ok);
+
+			if (!ok)
+				s->dropping = false;
+			else
+				s->drop_next = _codel_control(s, s->drop_next);
+		}
+	}
+	else if (ok)
+	{
+		_codel_drop(s, res);
+
+		res = ring_is_empty(r) ? NULL : _sojourn_dequeue(r, now, &ok);
+		s->dropping = true;
+
+		// close to the last dropping state its drop rate is a good start
+		uint32_t delta = s->count - s->lastcount;
+
+		s->count = delta > 1 && (int64_t)(now - s->drop_next) < (int64_t)(16 * s->interval) ?
+			delta : 1;
+		s->drop_next = _codel_control(s, now);
+		s->lastcount = s->count;
+	}
+
+	return res;
+}
+#endif
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the first element of the non empty ring r for everything but
+ * ring_pop. The sojourn time is accounted, CoDel only acts in ring_pop, so
+ * the caller always gets the element it asked for.
+ */
+static inline cp _ring_take_first(Ring r)
+{
+	ASSERT(!ring_is_empty(r));
+
+#ifdef RING_SOJOURN
+	if (r->sojourn)
+		_sojourn_note(r, _ring_now());
+#endif
+
+	return _ring_pop_first(r);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// BACKGROUND RECLAIMER
+
+// A ring waiting for ring_destroy on the reclaimer thread
+struct _RingJob
+{
+	Ring r;
+	void(*free_contend)(cp);
+	struct _RingJob* next;
+};
+
+static pthread_mutex_t _ring_reclaim_lock = PTHREAD_MUTEX_INITIALIZER;
+// signals new jobs to the reclaimer
+static pthread_cond_t _ring_reclaim_work = PTHREAD_COND_INITIALIZER;
+// signals ring_destroy_wait that pending dropped to 0
+static pthread_cond_t _ring_reclaim_done = PTHREAD_COND_INITIALIZER;
+static pthread_once_t _ring_reclaim_once = PTHREAD_ONCE_INIT;
+static struct _RingJob* _ring_reclaim_jobs;
+// jobs queued or in progress
+static uint64_t _ring_reclaim_pending;
+
+// -----------------------------------------------------------------------------
+/**
+ * Reclaimer thread, takes all queued jobs at once and destroys the rings.
+ */
+static void* _reclaim_main(void* moot)
+{
+	(void)moot;
+
+	pthread_mutex_lock(&_ring_reclaim_lock);
+
+	for (;;)
+	{
+		while (!_ring_reclaim_jobs)
+			pthread_cond_wait(&_ring_reclaim_work, &_ring_reclaim_lock);
+
+		struct _RingJob* job = _ring_reclaim_jobs;
+		uint64_t n = 0;
+
+		_ring_reclaim_jobs = NULL;
+
+		pthread_mutex_unlock(&_ring_reclaim_lock);
+
+		while (job)
+		{
+			struct _RingJob* done = job;
+
+			job = job->next;
+
+			ring_destroy(done->r, done->free_contend);
+			free(done);
+			n += 1;
+		}
+
+		pthread_mutex_lock(&_ring_reclaim_lock);
+
+		_ring_reclaim_pending -= n;
+
+		if (!_ring_reclaim_pending)
+			pthread_cond_broadcast(&_ring_reclaim_done);
+	}
+
+	return NULL;
+}
+
+static void _reclaim_start(void)
+{
+	pthread_t t;
+	pthread_attr_t attr;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	if (pthread_create(&t, &attr, _reclaim_main, NULL))
+		abort();
+
+	pthread_attr_destroy(&attr);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Hands the ring over to the reclaimer thread, starts it with the first job.
+ */
+static void _reclaim_push(Ring r, void(*free_contend)(cp))
+{
+	struct _RingJob* job = _smalloc(sizeof(*job));
+
+	job->r = r;
+	job->free_contend = free_contend;
+
+	pthread_once(&_ring_reclaim_once, _reclaim_start);
+	pthread_mutex_lock(&_ring_reclaim_lock);
+
+	job->next = _ring_reclaim_jobs;
+	_ring_reclaim_jobs = job;
+	_ring_reclaim_pending += 1;
+
+	pthread_cond_signal(&_ring_reclaim_work);
+	pthread_mutex_unlock(&_ring_reclaim_lock);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// MERGE
+
+// Head of one input of a k-way merge, src breaks ties between equal elements
+struct _RingMergeHead
+{
+	struct _Node* node;
+	uint64_t src;
+};
+
+struct _RingMerge
+{
+	int(*cmp)(cp a, cp b);
+	uint64_t n;
+	Ring* rings;
+	// binary min heap over the first nodes of the non empty rings
+	struct _RingMergeHead heap[];
+};
+
+// -----------------------------------------------------------------------------
+/**
+ * Order of the merge heap, stable with respect to the input order.
+ */
+static inline bool _merge_less(const struct _RingMergeHead* x, const struct _RingMergeHead* y,
+	int(*cmp)(cp a, cp b))
+{
+	int c = cmp(x->node->contend, y->node->contend);
+
+	return c < 0 || (c == 0 && x->src < y->src);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves heap[i] down to its place.
+ */
+static void _merge_sift(struct _RingMergeHead* heap, uint64_t n, uint64_t i, int(*cmp)(cp a, cp b))
+{
+	struct _RingMergeHead h = heap[i];
+
+	for (uint64_t c = 2 * i + 1; c < n; i = c, c = 2 * i + 1)
+	{
+		if (c + 1 < n && _merge_less(&heap[c + 1], &heap[c], cmp))
+			c += 1;
+
+		if (!_merge_less(&heap[c], &h, cmp))
+			break;
+
+		heap[i] = heap[c];
+	}
+
+	heap[i] = h;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Builds the heap of n heads.
+ */
+static void _merge_heapify(struct _RingMergeHead* heap, uint64_t n, int(*cmp)(cp a, cp b))
+{
+	for (uint64_t i = n / 2; i-- > 0; )
+		_merge_sift(heap, n, i, cmp);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// SEARCH
+
+// Nodes compared per block
+#define RING_SCAN_BLOCK 4
+
+/**
+ * Compares blocks of RING_SCAN_BLOCK nodes starting at n for as long as the
+ * nodes are linked one after another in memory and stay below hi. Adds the
+ * number of nodes with contend c to *hits, *first receives the offset of the
+ * first one. Stops after the first hit if first_only.
+ * @return Number of nodes consumed.
+ */
+typedef uint64_t (*_ring_run_fn)(const struct _Node* n, const struct _Node* hi, cp c,
+	bool first_only, uint64_t* hits, uint64_t* first);
+
+#if defined(__x86_64__)
+// -----------------------------------------------------------------------------
+/**
+ * Block compare, the contend pointers of two nodes per SSE2 register. Loads
+ * one node at a time, so it doesn't depend on the node size.
+ */
+static uint64_t _ring_run_sse2(const struct _Node* n, const struct _Node* hi, cp c,
+	bool first_only, uint64_t* hits, uint64_t* first)
+{
+	const struct _Node* start = n;
+	__m128i e = _mm_set1_epi64x((int64_t)(intptr_t)c);
+	__m128i step = _mm_set1_epi64x(RING_SCAN_BLOCK * sizeof(*n));
+	__m128i l0 = _mm_set_epi64x((int64_t)(intptr_t)(n + 2), (int64_t)(intptr_t)(n + 1));
+	__m128i l1 = _mm_set_epi64x((int64_t)(intptr_t)(n + 4), (int64_t)(intptr_t)(n + 3));
+
+	for (; n + RING_SCAN_BLOCK <= hi; n += RING_SCAN_BLOCK)
+	{
+		__m128i v0 = _mm_loadu_si128((const __m128i*)n);
+		__m128i v1 = _mm_loadu_si128((const __m128i*)(n + 1));
+		__m128i v2 = _mm_loadu_si128((const __m128i*)(n + 2));
+		__m128i v3 = _mm_loadu_si128((const __m128i*)(n + 3));
+
+		// next pointers of all four, the lower halves hold the contend
+		__m128i link = _mm_and_si128(_mm_cmpeq_epi32(_mm_unpackhi_epi64(v0, v1), l0),
+			_mm_cmpeq_epi32(_mm_unpackhi_epi64(v2, v3), l1));
+
+		if (_mm_movemask_epi8(link) != 0xFFFF)
+			break;
+
+		l0 = _mm_add_epi64(l0, step);
+		l1 = _mm_add_epi64(l1, step);
+
+		__m128i q0 = _mm_cmpeq_epi32(_mm_unpacklo_epi64(v0, v1), e);
+		__m128i q1 = _mm_cmpeq_epi32(_mm_unpacklo_epi64(v2, v3), e);
+
+		// SSE2 has no 64 bit compare, both 32 bit halves have to match
+		q0 = _mm_and_si128(q0, _mm_shuffle_epi32(q0, _MM_SHUFFLE(2, 3, 0, 1)));
+		q1 = _mm_and_si128(q1, _mm_shuffle_epi32(q1, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		uint32_t m = _mm_movemask_pd(_mm_castsi128_pd(q0)) |
+			_mm_movemask_pd(_mm_castsi128_pd(q1)) << 2;
+
+		if (m)
+		{
+			if (!*hits)
+				*first = n - start + __builtin_ctz(m);
+
+			*hits += __builtin_popcount(m);
+
+			if (first_only)
+				return n - start + RING_SCAN_BLOCK;
+		}
+	}
+
+	return n - start;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Block compare, two nodes per AVX2 register.
+ */
+__attribute__((target("avx2")))
+static uint64_t _ring_run_avx2(const struct _Node* n, const struct _Node* hi, cp c,
+	bool first_only, uint64_t* hits, uint64_t* first)
+{
+	const struct _Node* start = n;
+	int64_t ci = (int64_t)(intptr_t)c;
+	__m256i step = _mm256_set_epi64x(RING_SCAN_BLOCK * sizeof(*n), 0, RING_SCAN_BLOCK * sizeof(*n), 0);
+	__m256i e0 = _mm256_set_epi64x((int64_t)(intptr_t)(n + 2), ci, (int64_t)(intptr_t)(n + 1), ci);
+	__m256i e1 = _mm256_set_epi64x((int64_t)(intptr_t)(n + 4), ci, (int64_t)(intptr_t)(n + 3), ci);
+
+	for (; n + RING_SCAN_BLOCK <= hi; n += RING_SCAN_BLOCK)
+	{
+		__m256i v0 = _mm256_loadu_si256((const __m256i*)n);
+		__m256i v1 = _mm256_loadu_si256((const __m256i*)(n + 2));
+		uint32_t m0 = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v0, e0)));
+		uint32_t m1 = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v1, e1)));
+
+		// odd lanes hold the next pointers
+		if ((m0 & m1 & 0xA) != 0xA)
+			break;
+
+		e0 = _mm256_add_epi64(e0, step);
+		e1 = _mm256_add_epi64(e1, step);
+
+		uint32_t m = (m0 & 1) | (m0 >> 1 & 2) | (m1 & 1) << 2 | (m1 >> 1 & 2) << 2;
+
+		if (m)
+		{
+			if (!*hits)
+				*first = n - start + __builtin_ctz(m);
+
+			*hits += __builtin_popcount(m);
+
+			if (first_only)
+				return n - start + RING_SCAN_BLOCK;
+		}
+	}
+
+	return n - start;
+}
+#endif
+
+// -----------------------------------------------------------------------------
+/**
+ * Best block compare of this CPU, NULL if there is none.
+ */
+static _ring_run_fn _ring_run(void)
+{
+#if defined(__x86_64__)
+	static _ring_run_fn resolved;
+	_ring_run_fn res = __atomic_load_n(&resolved, __ATOMIC_RELAXED);
+
+	if (!res)
+	{
+		__builtin_cpu_init();
+		// the AVX2 compare reads two nodes per register
+		res = __builtin_cpu_supports("avx2") && sizeof(struct _Node) == 16 ?
+			_ring_run_avx2 : _ring_run_sse2;
+		__atomic_store_n(&resolved, res, __ATOMIC_RELAXED);
+	}
+
+	return res;
+#else
+	return NULL;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Counts the nodes with contend c, stops at the first one if first_only.
+ * *at receives the position of the first hit. Nodes inside an arena chunk
+ * go through the block compare, everything else is walked one by one.
+ */
+static uint64_t _ring_scan(Ring r, cp c, bool first_only, uint64_t* at)
+{
+	struct _RingArena* a = _ring_arena(r);
+	// positions count live nodes only, tombstones need the plain walk
+	_ring_run_fn run = a && !r->dead ? _ring_run() : NULL;
+	struct _Node* step = r->first;
+	uint64_t pos = 0;
+	uint64_t hits = 0;
+
+	while (step != NULL)
+	{
+		if (run && step->next == step + 1)
+		{
+			// the chunk around step is safe to read in blocks
+			uint64_t i = _arena_find(a, step);
+
+			if (i < a->chunks_len)
+			{
+				uint64_t first = 0;
+				uint64_t found = hits;
+				uint64_t n = run(step, a->chunks[i].base + a->chunks[i].n, c,
+					first_only, &found, &first);
+
+				if (found != hits)
+				{
+					if (!hits)
+						*at = pos + first;
+
+					if (first_only)
+						return 1;
+
+					hits = found;
+				}
+
+				if (n)
+				{
+					// last node of the run links to step + n
+					step += n;
+					pos += n;
+					continue;
+				}
+			}
+		}
+
+		if (r->dead && step->contend == RING_TOMBSTONE)
+		{
+			step = step->next;
+			continue;
+		}
+
+		if (step->contend == c)
+		{
+			if (!hits)
+				*at = pos;
+
+			if (first_only)
+				return 1;
+
+			hits += 1;
+		}
+
+		step = step->next;
+		pos += 1;
+	}
+
+	return hits;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// EXTERN INTERFACE FUNCTIONS
+
+// -----------------------------------------------------------------------------
+/**
+ * Create a new Ring.
+ * Complexity always O(1)
+ */
+Ring ring_create(void)
+{
+	Ring res = _smalloc(sizeof(*res));
+
+	res->size = 0;
+	res->first = NULL;
+	res->last = NULL;
+	res->arena = NULL;
+	res->rcu = NULL;
+	res->bound = NULL;
+	res->sojourn = NULL;
+	res->dead = 0;
+	res->sweep = NULL;
+	res->sweep_budget = 0;
+	res->dead_percent = RING_DEAD_PERCENT;
+	res->sweeping = false;
+	res->finger = NULL;
+	res->finger_pos = 0;
+
+	ASSERT(ring_check_invariant(res));
+
+	return res;	
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new Ring that holds at most cap elements.
+ * Complexity always O(1)
+ */
+Ring ring_create_bounded(uint64_t cap, enum RingPolicy policy)
+{
+	if (!cap || policy == RING_BLOCK)
+		return NULL;
+
+	Ring res = ring_create();
+
+	res->bound = _smalloc(sizeof(*res->bound));
+	res->bound->cap = cap;
+	res->bound->policy = policy;
+	res->bound->dropped = NULL;
+	res->bound->ud = NULL;
+	res->bound->drops = 0;
+	res->bound->rejects = 0;
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Sets the callback for elements dropped by RING_DROP_OLDEST.
+ * Complexity always O(1)
+ */
+void ring_on_drop(Ring r, void(*dropped)(cp c, void* ud), void* ud)
+{
+	if (!r->bound)
+		return;
+
+	r->bound->dropped = dropped;
+	r->bound->ud = ud;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of dropped elements.
+ * Complexity always O(1)
+ */
+uint64_t ring_drops(Ring r)
+{
+	return r->bound ? r->bound->drops : 0;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of refused elements.
+ * Complexity always O(1)
+ */
+uint64_t ring_rejects(Ring r)
+{
+	return r->bound ? r->bound->rejects : 0;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Starts tracking sojourn times.
+ * Complexity always O(1)
+ */
+bool ring_sojourn_enable(Ring r)
+{
+#ifdef RING_SOJOURN
+	if (!r->sojourn)
+		r->sojourn = calloc(1, sizeof(*r->sojourn));
+
+	if (!r->sojourn)
+		abort();
+
+	return true;
+#else
+	(void)r;
+	return false;
+#endif
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies the sojourn histogram.
+ * Complexity always O(1)
+ */
+void ring_sojourn_histogram(Ring r, uint64_t counts[RING_SOJOURN_BUCKETS])
+{
+	for (int b = 0; b < RING_SOJOURN_BUCKETS; ++b)
+		counts[b] = r->sojourn ? r->sojourn->hist[b] : 0;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Upper bound of the sojourn time quantile q.
+ * Complexity always O(1)
+ */
+uint64_t ring_sojourn_quantile(Ring r, double q)
+{
+	uint64_t total = 0;
+	uint64_t seen = 0;
+
+	if (!r->sojourn)
+		return 0;
+
+	for (int b = 0; b < RING_SOJOURN_BUCKETS; ++b)
+		total += r->sojourn->hist[b];
+
+	for (int b = 0; b < RING_SOJOURN_BUCKETS && total; ++b)
+	{
+		seen += r->sojourn->hist[b];
+
+		if (seen && seen >= q * total)
+			return b < 63 ? (2UL << b) - 1 : UINT64_MAX;
+	}
+
+	return 0;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Clears the sojourn histogram.
+ * Complexity always O(1)
+ */
+void ring_sojourn_reset(Ring r)
+{
+	if (r->sojourn)
+		memset(r->sojourn->hist, 0, sizeof(r->sojourn->hist));
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Sets up CoDel on ring_pop.
+ * Complexity always O(1)
+ */
+bool ring_codel(Ring r, uint64_t target_ns, uint64_t interval_ns,
+	void(*dropped)(cp c, void* ud), void* ud)
+{
+	if (!ring_sojourn_enable(r))
+		return false;
+
+	struct _RingSojourn* s = r->sojourn;
+
+	s->target = target_ns;
+	s->interval = interval_ns ? interval_ns : 1;
+	s->dropped = dropped;
+	s->ud = ud;
+	s->first_above = 0;
+	s->dropping = false;
+
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements dropped by CoDel.
+ * Complexity always O(1)
+ */
+uint64_t ring_codel_drops(Ring r)
+{
+	return r->sojourn ? r->sojourn->drops : 0;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a node arena.
+ * Complexity always O(1)
+ */
+RingArena ring_arena_create(uint64_t chunk_nodes)
+{
+	return _arena_new(chunk_nodes);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a node arena on huge pages.
+ * Complexity always O(1)
+ */
+RingArena ring_arena_create_huge(uint64_t chunk_nodes)
+{
+	struct _RingArena* a = _arena_new(chunk_nodes ? chunk_nodes :
+		RING_HUGE_PAGE / sizeof(struct _Node));
+
+	a->huge = true;
+
+	return a;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves a heap ring into a private huge page arena.
+ * Complexity always O(n)
+ */
+bool ring_hugepages(Ring r)
+{
+	ASSERT(ring_check_invariant(r));
+
+	if (r->arena)
+		return false;
+
+	r->arena = ring_arena_create_huge(0);
+
+	// the heap nodes go back to malloc during the compaction
+	if (!ring_is_empty(r))
+	{
+		r->arena->foreign = true;
+		ring_compact(r);
+	}
+
+	ASSERT(ring_check_invariant(r));
+
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a node arena on a NUMA node.
+ * Complexity always O(1)
+ */
+RingArena ring_arena_create_numa(uint64_t chunk_nodes, int node)
+{
+	if (!_numa_allowed(node))
+		return NULL;
+
+	struct _RingArena* a = _arena_new(chunk_nodes);
+
+	a->numa = node;
+
+	return a;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the nodes of r onto a NUMA node.
+ * Complexity always O(n)
+ */
+bool ring_migrate(Ring r, int node)
+{
+	ASSERT(ring_check_invariant(r));
+	ASSERT(!r->rcu, "ring_migrate in concurrent mode");
+
+	struct _RingArena* a = ring_arena_create_numa(0, node);
+	struct _RingArena* old = _ring_arena(r);
+
+	if (!a)
+		return false;
+
+	if (old)
+		a->huge = old->huge;
+
+	if (!ring_is_empty(r))
+		_ring_move_nodes(r, _arena_chunk(a, ring_size(r)), old);
+
+	// heap nodes of a foreign arena went back to malloc on the way
+	if (old)
+		_arena_unref(old);
+
+	r->arena = a;
+	r->finger_pos = 0;
+
+	ASSERT(ring_check_invariant(r));
+
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * NUMA node of the arena of r.
+ * Complexity always O(1)
+ */
+int ring_numa_node(Ring r)
+{
+	struct _RingArena* a = _ring_arena(r);
+
+	return a ? a->numa : -1;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * NUMA node the memory at p is placed on.
+ * Complexity always O(1)
+ */
+int ring_numa_locate(const void* p)
+{
+	int node = -1;
+
+	if (syscall(SYS_get_mempolicy, &node, NULL, 0, p, RING_MPOL_F_NODE | RING_MPOL_F_ADDR))
+		return -1;
+
+	return node;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Gives up the creator handle of an arena.
+ * Complexity O(chunks) if this was the last reference, else O(1)
+ */
+void ring_arena_destroy(RingArena a)
+{
+	if (a)
+		_arena_unref(a);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new Ring that takes its nodes from the arena a.
+ * Complexity always O(1)
+ */
+Ring ring_create_in(RingArena a)
+{
+	Ring res = ring_create();
+
+	if (a)
+	{
+		while (a->merged)
+			a = a->merged;
+
+		a->refs += 1;
+		res->arena = a;
+	}
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the arena of a ring. NULL if the nodes live on the heap.
+ * Complexity always O(1)
+ */
+RingArena ring_arena(Ring r)
+{
+	return _ring_arena(r);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Releases every chunk of the arena that holds no live node anymore.
+ * Complexity O(f * log(chunks)) with f free nodes in the arena
+ * @return Number of bytes released.
+ */
+uint64_t ring_arena_trim(RingArena a)
+{
+	while (a->merged)
+		a = a->merged;
+
+	if (a->pending)
+		_arena_settle(a);
+
+	if (!a->chunks_len)
+		return 0;
+
+	uint64_t* nfree = calloc(a->chunks_len, sizeof(*nfree));
+	uint64_t released = 0;
+	uint64_t len = 0;
+	struct _Node** link = &a->free;
+	struct _Node* last = NULL;
+
+	if (!nfree)
+		abort();
+
+	for (struct _Node* n = a->free; n != NULL; n = n->next)
+		nfree[_arena_find(a, n)] += 1;
+
+	// unlink the nodes of chunks that are about to go
+	while (*link)
+	{
+		uint64_t i = _arena_find(a, *link);
+
+		if (nfree[i] == a->chunks[i].n)
+		{
+			*link = (*link)->next;
+		}
+		else
+		{
+			last = *link;
+			link = &last->next;
+		}
+	}
+
+	a->free_last = last;
+
+	for (uint64_t i = 0; i < a->chunks_len; ++i)
+	{
+		if (nfree[i] == a->chunks[i].n)
+		{
+			released += a->chunks[i].n * sizeof(struct _Node);
+			_chunk_release(a->chunks + i);
+		}
+		else
+		{
+			a->chunks[len++] = a->chunks[i];
+		}
+	}
+
+	a->chunks_len = len;
+	free(nfree);
+
+	return released;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Switches the per-thread node cache on or off.
+ * Complexity always O(1)
+ */
+void ring_node_cache(bool on)
+{
+	__atomic_store_n(&_ring_cache_on, on, __ATOMIC_RELAXED);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Frees the cached nodes of the calling thread and of the depot.
+ * Complexity O(cached nodes)
+ */
+uint64_t ring_node_cache_trim(void)
+{
+	struct _RingMags* m = &_ring_mags;
+	uint64_t released = (m->loaded_n + m->spare_n) * sizeof(struct _Node);
+
+	_mag_free(m->loaded);
+	_mag_free(m->spare);
+
+	m->loaded = NULL;
+	m->loaded_n = 0;
+	m->spare = NULL;
+	m->spare_n = 0;
+
+	pthread_mutex_lock(&_ring_depot_lock);
+
+	struct _Node* mag = _ring_depot;
+
+	released += _ring_depot_n * RING_MAG_NODES * sizeof(struct _Node);
+	_ring_depot = NULL;
+	_ring_depot_n = 0;
+
+	pthread_mutex_unlock(&_ring_depot_lock);
+
+	while (mag != NULL)
+	{
+		struct _Node* next = mag->contend;
+
+		_mag_free(mag);
+		mag = next;
+	}
+
+	return released;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a Ring. Heap nodes may stay in the node cache.
+ * Complexity always O(n)
+ */
+void ring_destroy(Ring r, void(*free_contend)(cp))
+{
+	ASSERT(ring_check_invariant(r));
+
+	PROBE(destroy, r, ring_size(r));
+
+	struct _Node* tmp; 
+	struct _RingArena* a = _ring_arena(r);
+
+	if(r->rcu)
+		_rcu_disable(r);
+
+	// the whole chain goes onto the free list at once
+	if(a && !a->foreign && !free_contend && r->first)
+	{
+		_arena_free_chain(a, r->first, r->last);
+		r->first = NULL;
+	}
+		
+	while(r->first != NULL)
+	{
+		tmp = r->first;
+		r->first = r->first->next;
+
+		if(free_contend && tmp->contend != RING_TOMBSTONE)
+			free_contend(tmp->contend);
+
+		_ring_free_node(r, tmp);
+	}
+
+	_ring_free_base(r);
+	r = NULL;
+
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a Ring on the background reclaimer thread.
+ * Complexity O(1), O(n) with free_contend for rings of a shared arena
+ */
+void ring_destroy_async(Ring r, void(*free_contend)(cp))
+{
+	ASSERT(ring_check_invariant(r));
+
+	struct _RingArena* a = _ring_arena(r);
+
+	// nodes of a shared arena have to go back on the owning thread, that
+	// is O(1) without free_contend anyway. The creator handle counts, it
+	// can still make rings that take nodes from the free list
+	if (ring_is_empty(r) || (a && a->refs > 1))
+	{
+		ring_destroy(r, free_contend);
+		return;
+	}
+
+	_reclaim_push(r, free_contend);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys up to budget elements of the ring, the ring itself with the
+ * last one.
+ * Complexity O(budget)
+ */
+bool ring_destroy_step(Ring r, void(*free_contend)(cp), uint64_t budget)
+{
+	struct _RingArena* a = _ring_arena(r);
+
+	// the chain goes onto the free list in one step
+	if (!free_contend && a && !a->foreign)
+	{
+		ring_destroy(r, NULL);
+		return true;
+	}
+
+	for (; budget && !ring_is_empty(r); --budget)
+	{
+		cp c = _ring_pop_first(r);
+
+		if (free_contend)
+			free_contend(c);
+	}
+
+	if (!ring_is_empty(r))
+		return false;
+
+	ring_destroy(r, NULL);
+
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Blocks until the reclaimer thread has destroyed all rings handed to it.
+ * Complexity O(pending nodes)
+ */
+void ring_destroy_wait(void)
+{
+	pthread_mutex_lock(&_ring_reclaim_lock);
+
+	while (_ring_reclaim_pending)
+		pthread_cond_wait(&_ring_reclaim_done, &_ring_reclaim_lock);
+
+	pthread_mutex_unlock(&_ring_reclaim_lock);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the beginning of the ring.
+ * Complexity always O(1)
+ */
+bool ring_push(Ring r, cp c)
+{
+	ASSERT(ring_check_invariant(r));
+
+	PROBE(push, r, ring_size(r));
+
+	if (r->bound && !_ring_room(r))
+		return false;
+
+	struct _Node* tmp = _ring_create_node(r, r->first, c);
+
+	_ring_seq_begin(r);
+
+	r->first = tmp;
+
+	if (ring_is_empty(r))
+		r->last = r->first;
+
+	r->size += 1;
+	r->finger_pos += 1;
+
+	_ring_seq_end(r);
+
+	if (r->sweeping)
+		_ring_sweep(r, r->sweep_budget);
+
+	ASSERT(ring_check_invariant(r));
+
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the end of the ring.
+ * Complexity always O(1)
+ */
+bool ring_append(Ring r, cp c)
+{
+	ASSERT(ring_check_invariant(r));
+
+	PROBE(append, r, ring_size(r));
+
+	if (r->bound && !_ring_room(r))
+		return false;
+
+	struct _Node* tmp = _ring_create_node(r, NULL, c);
+
+	_ring_seq_begin(r);
+
+	if (ring_is_empty(r))
+		r->first = tmp;
+	else
+		r->last->next = tmp;
+
+	r->last = tmp;
+
+	r->size += 1;
+
+	_ring_seq_end(r);
+
+	if (r->sweeping)
+		_ring_sweep(r, r->sweep_budget);
+
+	ASSERT(ring_check_invariant(r));
+
+	return true;
+}
+
+
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element of the ring. 
+ * NULL if the ring is empty.
+ * Complexity always O(1)
+ */
+cp ring_pop(Ring r)
+{
+	ASSERT(ring_check_invariant(r));
+
+	PROBE(pop, r, ring_size(r));
+
+	if (ring_is_empty(r))
+		return NULL;
+
+#ifdef RING_SOJOURN
+	if (r->sojourn)
+		return _sojourn_pop(r);
+#endif
+
+	cp res = _ring_pop_first(r);
+
+	ASSERT(ring_check_invariant(r));
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the last element of the ring. 
+ * NULL if the ring is empty.
+ * CAUTION!!!! Complexity always O(n)
+ */
+cp ring_chop(Ring r)
+{
+	ASSERT(ring_check_invariant(r));
+
+	PROBE(chop, r, ring_size(r), ring_size(r) + ring_dead(r));
+
+	if (ring_is_empty(r))
+		return NULL;
+
+	if (r->dead)
+		_ring_purge(r);
+
+	cp res = r->last->contend;
+    
+	if(ring_size(r) == 1)
+	{
+		_ring_free_node(r, r->last);
+		r->last = NULL;
+		r->first = NULL;
+	}
+	else
+	{
+		struct _Node* tmp = r->first;
+
+		while(tmp->next->next != NULL)
+		{
+			tmp = tmp->next;
+		}
+
+		r->last = tmp;
+
+		_ring_free_node(r, tmp->next);
+		tmp->next = NULL;
+	}
+
+	r->size -= 1;
+
+	ASSERT(ring_check_invariant(r));
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Return the contend of a specified position. 
+ * NULL if out of bounds or the contend was NULL in the first place. 
+ * Complexity always O(i)
+ */
+cp ring_at (Ring r, uint64_t i)
+{
+	ASSERT(ring_check_invariant(r));
+
+	if (i >= ring_size(r))
+		return NULL;
+	
+	return _ring_seek(r, i, NULL)->contend;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Extracts an element on a specified position.
+ * NULL if out of bounds or the contend was NULL in the first place. 
+ * Complexity always O(i)
+ */
+cp ring_extract(Ring r, uint64_t i)
+{
+	ASSERT(ring_check_invariant(r));
+
+	PROBE(extract, r, ring_size(r), i, _ring_walk(r, i, true));
+
+	if (i >= ring_size(r))
+		return NULL;
+	
+	if(i == 0)
+	{
+		return _ring_take_first(r);
+	}
+	else
+	{
+		struct _Node* step;
+		struct _Node* delme = _ring_seek(r, i, &step); 
+		cp res = delme->contend;
+
+		step->next = delme->next;
+
+		if(delme == r->last)
+			r->last = step;
+
+		// the finger goes back to the predecessor
+		r->finger = step;
+		r->finger_pos = step->contend == RING_TOMBSTONE ? i : i - 1;
+
+		_ring_free_node(r, delme);
+
+		r->size -= 1;
+
+		ASSERT(ring_check_invariant(r));
+
+		return res; 
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Inserts an element on a specified position.
+ * Complexity always O(i)
+ */
+bool ring_insert_at(Ring r, cp c, uint64_t i)
+{
+	ASSERT(ring_check_invariant(r));
+
+	PROBE(insert_at, r, ring_size(r), i, _ring_walk(r, i, true));
+
+	if (i > ring_size(r))
+		return false;
+
+	uint64_t size = ring_size(r);
+
+	if (r->bound && !_ring_room(r))
+		return false;
+
+	// a dropped head moves every position up by one
+	if (i && ring_size(r) < size)
+		i -= 1;
+
+	if (i == 0)
+	{
+		ring_push(r, c);
+	}
+	else if (i == ring_size(r))
+	{
+		ring_append(r, c);
+	}
+	else
+	{
+		struct _Node * step;
+
+		_ring_seek(r, i, &step);
+
+		step->next = _ring_create_node(r, step->next, c); 
+		r->finger = step->next;
+
+		r->size += 1;
+	}
+
+	ASSERT(ring_check_invariant(r));
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the element of node n lazily, the node stays as a tombstone.
+ * Complexity O(1), plus the compaction if the threshold is crossed
+ */
+cp ring_tombstone(Ring r, RingNode n)
+{
+	ASSERT(ring_check_invariant(r));
+	ASSERT(!r->rcu, "tombstones in concurrent mode");
+	ASSERT(n->contend != RING_TOMBSTONE, "node removed twice");
+
+	// the first node is never a tombstone
+	if (n == r->first)
+		return _ring_take_first(r);
+
+	cp res = n->contend;
+
+	n->contend = RING_TOMBSTONE;
+	r->size -= 1;
+	r->dead += 1;
+	// position of n is unknown, the finger may be behind it
+	r->finger = NULL;
+
+	if (!r->sweeping && r->dead_percent &&
+		r->dead * 100 >= (r->size + r->dead) * r->dead_percent)
+	{
+		r->sweeping = true;
+		r->sweep = NULL;
+	}
+
+	if (r->sweeping)
+		_ring_sweep(r, r->sweep_budget ? r->sweep_budget : UINT64_MAX);
+
+	ASSERT(ring_check_invariant(r));
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Sets when tombstones are compacted.
+ * Complexity always O(1)
+ */
+void ring_tombstone_policy(Ring r, uint8_t percent, uint32_t budget)
+{
+	r->dead_percent = percent > 100 ? 100 : percent;
+	r->sweep_budget = budget;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Unlinks and frees all tombstones now.
+ * Complexity always O(n)
+ */
+void ring_purge(Ring r)
+{
+	ASSERT(ring_check_invariant(r));
+
+	if (r->dead)
+		_ring_purge(r);
+
+	ASSERT(ring_check_invariant(r));
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Turns the chain so that node n with predecessor prev comes first.
+ */
+static void _ring_turn(Ring r, struct _Node* prev, struct _Node* n)
+{
+	r->last->next = r->first;
+	r->first = n;
+	r->last = prev;
+	prev->next = NULL;
+
+	// positions changed
+	r->finger = NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the first k elements to the end, no node is allocated or freed.
+ * Complexity O(k % ring_size(r)), O(1) for k = 1 without tombstones
+ */
+void ring_rotate(Ring r, uint64_t k)
+{
+	ASSERT(ring_check_invariant(r));
+	ASSERT(!r->rcu, "ring_rotate in concurrent mode");
+
+	if (ring_size(r) < 2 || !(k %= ring_size(r)))
+		return;
+
+	struct _Node* prev;
+	uint64_t dead;
+	struct _Node* n = _ring_locate(r, k, &prev, &dead);
+
+	_ring_turn(r, prev, n);
+
+	ASSERT(ring_check_invariant(r));
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Rotates the ring until the element of node n is the first one.
+ * Complexity O(i) with i the position of n
+ */
+void ring_rotate_to(Ring r, RingNode n)
+{
+	ASSERT(ring_check_invariant(r));
+	ASSERT(!r->rcu, "ring_rotate_to in concurrent mode");
+	ASSERT(n->contend != RING_TOMBSTONE, "rotate to a removed node");
+
+	if (n == r->first)
+		return;
+
+	struct _Node* prev = r->first;
+
+	while (prev->next != n)
+		prev = prev->next;
+
+	_ring_turn(r, prev, n);
+
+	ASSERT(ring_check_invariant(r));
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Puts the cursor c on the first element of r.
+ * Complexity always O(1)
+ */
+void ring_cursor_init(Ring r, RingCursor* c)
+{
+	c->ring = r;
+	c->node = r->first;
+	c->pos = 0;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the cursor to the next element.
+ * Complexity always O(1)
+ */
+bool ring_cursor_advance(RingCursor* c)
+{
+	if (!c->node)
+		return false;
+
+	c->node = _ring_live(c->node->next);
+	c->pos += 1;
+
+	return c->node != NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Inserts v behind the current element.
+ * Complexity always O(1)
+ */
+bool ring_cursor_insert_after(RingCursor* c, cp v)
+{
+	Ring r = c->ring;
+
+	ASSERT(ring_check_invariant(r));
+
+	if (!c->node)
+		return false;
+
+	// dropping could take the node of the cursor, so a full ring refuses
+	if (r->bound && ring_size(r) >= r->bound->cap)
+	{
+		r->bound->rejects += 1;
+		return false;
+	}
+
+	c->node->next = _ring_create_node(r, c->node->next, v);
+
+	if (c->node == r->last)
+		r->last = c->node->next;
+
+	r->size += 1;
+	r->finger = NULL;
+
+	ASSERT(ring_check_invariant(r));
+
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the element behind the current one.
+ * Complexity always O(1)
+ */
+cp ring_cursor_remove_after(RingCursor* c)
+{
+	Ring r = c->ring;
+
+	ASSERT(ring_check_invariant(r));
+
+	if (!c->node)
+		return NULL;
+
+	// tombstones in between stay where they are
+	struct _Node* step = c->node;
+
+	while (step->next != NULL && step->next->contend == RING_TOMBSTONE)
+		step = step->next;
+
+	struct _Node* delme = step->next;
+
+	if (!delme)
+		return NULL;
+
+	cp res = delme->contend;
+
+	step->next = delme->next;
+
+	if (delme == r->last)
+		r->last = step;
+
+	r->size -= 1;
+	r->finger = NULL;
+
+	_ring_free_node(r, delme);
+
+	ASSERT(ring_check_invariant(r));
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes a group of elements out of the ring and stores them in an other
+ * Ring. del_func defines which element will be removed. Own userdata can 
+ * be passed to the del_func with the last parameter.
+ * Complexity always O(n)
+ */
+Ring ring_remove_selected(Ring r, bool(*del_func)(cp c, void* ud), void* ud)
+{
+	ASSERT(ring_check_invariant(r));
+
+	PROBE(remove_selected, r, ring_size(r), ring_size(r) + ring_dead(r));
+
+	Ring res = ring_create_in(_ring_arena(r));
+
+	if (r->dead)
+		_ring_purge(r);
+
+	r->finger = NULL;
+
+	while (!ring_is_empty(r))
+	{ 
+		if (del_func(ring_first(r), ud))
+			ring_append(res, _ring_pop_first(r));
+		else
+			break;
+	}
+
+	// r->first guaranteed not in res
+	struct _Node* step = r->first;
+
+	struct _Node* delme = NULL;
+
+	while (step != NULL && step->next != NULL)
+	{
+		if (del_func(step->next->contend, ud))
+		{
+			ring_append(res, step->next->contend);
+
+			delme = step->next;
+			step->next = step->next->next;
+
+			if(delme == r->last)
+				r->last = step;
+
+			_ring_free_node(r, delme);
+
+			r->size -= 1;
+		}
+		else
+		{
+			step = step->next;
+		}
+	}
+
+	ASSERT(ring_check_invariant(r));
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Concatenation of two rings. Don't use r1 & r2 after the call of this funktion.
+ * Only the returned ring is supposed to be touched again.
+ * Complexity always O(1)
+ */
+Ring ring_concat(Ring r1, Ring r2)
+{
+	ASSERT(ring_check_invariant(r1));
+	ASSERT(ring_check_invariant(r2));
+
+	PROBE(concat, r1, ring_size(r1), r2, ring_size(r2));
+
+	if(ring_is_empty(r1))
+	{
+		// the limit of r1 stays with the result
+		struct _RingBound* b = r2->bound;
+
+		r2->bound = r1->bound;
+		r1->bound = b;
+
+		_ring_free_base(r1);
+		return r2;
+	}
+	else if(ring_is_empty(r2))
+	{
+		_ring_free_base(r2);
+		return r1;
+	}
+
+	_ring_adopt(r1, r2);
+
+	r1->last->next = r2->first;
+	r1->last = r2->last;
+	r1->size += r2->size;
+	r1->dead += r2->dead;
+
+	_ring_free_base(r2);
+
+	ASSERT(ring_check_invariant(r1));
+
+	return r1;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Concatenation of k rings, in array order.
+ * Complexity always O(k)
+ */
+Ring ring_concat_n(Ring* rings, uint64_t k)
+{
+	if (!k)
+		return ring_create();
+
+	Ring res = rings[0];
+
+	for (uint64_t i = 1; i < k; ++i)
+		res = ring_concat(res, rings[i]);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Merges k sorted rings into one.
+ * Complexity O(n log k)
+ */
+Ring ring_merge_sorted(Ring* rings, uint64_t k, int(*cmp)(cp a, cp b))
+{
+	if (!k)
+		return ring_create();
+
+	Ring res = rings[0];
+	struct _RingMergeHead* heap = malloc(k * sizeof(*heap));
+	uint64_t n = 0;
+	uint64_t size = 0;
+
+	if (!heap)
+		abort();
+
+	for (uint64_t i = 0; i < k; ++i)
+	{
+		ASSERT(ring_check_invariant(rings[i]));
+		ASSERT(!rings[i]->rcu, "ring_merge_sorted in concurrent mode");
+
+		if (rings[i]->dead)
+			_ring_purge(rings[i]);
+
+		if (i)
+			_ring_adopt(res, rings[i]);
+
+		if (rings[i]->first)
+			heap[n++] = (struct _RingMergeHead){ rings[i]->first, i };
+
+		size += rings[i]->size;
+	}
+
+	_merge_heapify(heap, n, cmp);
+
+	struct _Node head = { .next = NULL };
+	struct _Node* tail = &head;
+
+	while (n > 1)
+	{
+		struct _Node* node = heap[0].node;
+
+		tail->next = node;
+		tail = node;
+
+		if (!(heap[0].node = node->next))
+			heap[0] = heap[--n];
+
+		_merge_sift(heap, n, 0, cmp);
+	}
+
+	// the rest of the last input is linked in one piece
+	if (n)
+	{
+		tail->next = heap[0].node;
+		tail = rings[heap[0].src]->last;
+	}
+
+	res->first = head.next;
+	res->last = size ? tail : NULL;
+	res->size = size;
+	res->sweep = NULL;
+	res->finger = NULL;
+	res->finger_pos = 0;
+
+	for (uint64_t i = 1; i < k; ++i)
+	{
+		rings[i]->first = rings[i]->last = NULL;
+		rings[i]->size = 0;
+
+		_ring_free_base(rings[i]);
+	}
+
+	free(heap);
+
+	ASSERT(ring_check_invariant(res));
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Starts a streaming merge of k sorted rings.
+ * Complexity O(k)
+ */
+RingMerge ring_merge_open(Ring* rings, uint64_t k, int(*cmp)(cp a, cp b))
+{
+	RingMerge res = malloc(sizeof(*res) + k * sizeof(struct _RingMergeHead) + k * sizeof(Ring));
+
+	if (!res)
+		abort();
+
+	res->cmp = cmp;
+	res->n = 0;
+	res->rings = (Ring*)(res->heap + k);
+
+	for (uint64_t i = 0; i < k; ++i)
+	{
+		ASSERT(!rings[i]->rcu, "ring_merge_open in concurrent mode");
+
+		res->rings[i] = rings[i];
+
+		if (rings[i]->first)
+			res->heap[res->n++] = (struct _RingMergeHead){ rings[i]->first, i };
+	}
+
+	_merge_heapify(res->heap, res->n, cmp);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Pops the smallest first element of all rings.
+ * Complexity O(log k)
+ */
+cp ring_merge_next(RingMerge m)
+{
+	if (!m->n)
+		return NULL;
+
+	Ring r = m->rings[m->heap[0].src];
+	cp res = _ring_take_first(r);
+
+	// popping skips tombstones, the first node is live again
+	if (!(m->heap[0].node = r->first))
+		m->heap[0] = m->heap[--m->n];
+
+	_merge_sift(m->heap, m->n, 0, m->cmp);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Ends the merge.
+ * Complexity always O(1)
+ */
+void ring_merge_close(RingMerge m)
+{
+	free(m);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Splits the ring before position i. r keeps the first i elements.
+ * Complexity always O(i)
+ */
+Ring ring_split_at(Ring r, uint64_t i)
+{
+	ASSERT(ring_check_invariant(r));
+
+	if (i > ring_size(r))
+		return NULL;
+
+	Ring res = ring_create_in(_ring_arena(r));
+
+	if (i == ring_size(r))
+		return res;
+
+	if (i == 0)
+	{
+		res->first = r->first;
+		res->last = r->last;
+		res->size = r->size;
+		res->dead = r->dead;
+
+		r->first = NULL;
+		r->last = NULL;
+		r->size = 0;
+		r->dead = 0;
+		r->sweeping = false;
+		r->sweep = NULL;
+		r->finger = NULL;
+
+		return res;
+	}
+
+	struct _Node* step;
+	uint64_t dead;
+
+	res->first = _ring_locate(r, i, &step, &dead);
+	res->last = r->last;
+	res->size = r->size - i;
+	res->dead = r->dead - dead;
+
+	step->next = NULL;
+	r->last = step;
+	r->size = i;
+	r->dead = dead;
+	// sweep position and finger may have gone to res
+	r->sweep = NULL;
+	r->finger = NULL;
+
+	ASSERT(ring_check_invariant(r));
+	ASSERT(ring_check_invariant(res));
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Distributes the contend of one ring over M other rings.
+ * Complexity always O(n). A call with M=0 will result in M=1.
+ * The input ring is still usable after this function.
+ *
+ * @return A ring containing M rings which comtain an nth part of the input ring.
+ */
+Ring ring_distribute(Ring r, uint64_t m)
+{
+	ASSERT(ring_check_invariant(r));
+	if (!m)
+		m = 1;
+	
+	Ring * ring_vector = _smalloc(sizeof(Ring*) * m);
+	uint64_t i = 0;
+
+	for(uint64_t i = 0; i < m; ++i)
+	{
+		ring_vector[i] = ring_create();
+	}
+
+	for(ring_iterator(r))
+	{
+		ring_append(ring_vector[ i%m ], ring_index);
+		++i;
+	}
+
+
+	Ring res = ring_create();
+
+	for(uint64_t i = 0; i < m; ++i)
+	{
+		ring_append(res, ring_vector[i]);
+	}
+	
+	free(ring_vector);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves every element of r to the end of the bucket of its key. A bounded
+ * bucket applies its policy like ring_append.
+ * Complexity always O(n)
+ */
+void ring_bucketize(Ring r, Ring* buckets, uint64_t k, uint64_t(*key)(cp c, void* ud), void* ud)
+{
+	ASSERT(ring_check_invariant(r));
+	ASSERT(k > 0);
+	ASSERT(!r->rcu, "ring_bucketize in concurrent mode");
+
+	if (ring_is_empty(r))
+		return;
+
+	for (uint64_t j = 0; j < k; ++j)
+	{
+		ASSERT(buckets[j] != r && !buckets[j]->rcu);
+
+		_ring_adopt(buckets[j], r);
+	}
+
+	struct _Node* next;
+	// elements refused by a full bucket stay in r, in order
+	struct _Node* first = NULL;
+	struct _Node* last = NULL;
+	uint64_t size = 0;
+
+	for (struct _Node* n = r->first; n; n = next)
+	{
+		next = n->next;
+
+		if (n->contend == RING_TOMBSTONE)
+		{
+			_ring_free_node(r, n);
+			continue;
+		}
+
+		Ring b = buckets[key(n->contend, ud) % k];
+
+		n->next = NULL;
+
+		if (b->bound && !_ring_room(b))
+		{
+			if (last)
+				last->next = n;
+			else
+				first = n;
+
+			last = n;
+			size += 1;
+			continue;
+		}
 
-	r->size += 1;
+		if (b->last)
+			b->last->next = n;
+		else
+			b->first = n;
 
-	ASSERT(ring_check_invariant(r));
-}
+		b->last = n;
+		b->size += 1;
+	}
 
+	r->first = first;
+	r->last = last;
+	r->size = size;
+	r->dead = 0;
+	r->sweep = NULL;
+	r->finger = NULL;
+	r->finger_pos = 0;
 
+	for (uint64_t j = 0; j < k; ++j)
+	{
+		ASSERT(ring_check_invariant(buckets[j]));
+	}
+}
 
 
 // -----------------------------------------------------------------------------
 /**
- * Removes and returns the first element of the ring. 
- * NULL if the ring is empty.
- * Complexity always O(1)
+ * Moves all nodes into one contiguous block, in list order.
+ * Complexity always O(n)
  */
-cp ring_pop(Ring r)
+void ring_compact(Ring r)
 {
 	ASSERT(ring_check_invariant(r));
 
 	if (ring_is_empty(r))
-		return NULL;
-	
-	cp res = r->first->contend;
+		return;
 
-	struct _Node * delme = r->first;
-	
-	r->first = r->first->next;
-	
-	free(delme);
+	struct _RingArena* a = _ring_arena(r);
+	bool heap = !a;
 
-	if(ring_size(r) == 1)
-		r->last = NULL;
+	if (heap)
+		r->arena = a = _arena_new(0);
 
-	r->size -= 1;
+	_ring_move_nodes(r, _arena_chunk(a, ring_size(r)), heap ? NULL : a);
 
 	ASSERT(ring_check_invariant(r));
-
-	return res;
 }
 
 
 // -----------------------------------------------------------------------------
 /**
- * Removes and returns the last element of the ring. 
- * NULL if the ring is empty.
- * CAUTION!!!! Complexity always O(n)
+ * Copies the contend of the ring in order into out.
+ * Complexity always O(n)
  */
-cp ring_chop(Ring r)
+uint64_t ring_to_array(Ring r, cp* out, bool consume)
 {
 	ASSERT(ring_check_invariant(r));
 
-	if (ring_is_empty(r))
-		return NULL;
+	uint64_t n = ring_size(r);
+	uint64_t i = 0;
+	struct _Node* step = r->first;
 
-	cp res = r->last->contend;
-    
-	if(ring_size(r) == 1)
+	if (!consume || r->dead)
 	{
-		free(r->last);
-		r->last = NULL;
-		r->first = NULL;
+		for (; step != NULL; step = step->next)
+			if (step->contend != RING_TOMBSTONE)
+				out[i++] = step->contend;
+
+		if (!consume)
+			return n;
 	}
 	else
 	{
-		struct _Node* tmp = r->first;
+		for (; i < n; ++i, step = step->next)
+			out[i] = step->contend;
+	}
 
-		while(tmp->next->next != NULL)
+	struct _RingArena* a = _ring_arena(r);
+
+	if (a && !a->foreign && !r->rcu && n)
+	{
+		_arena_free_chain(a, r->first, r->last);
+	}
+	else
+	{
+		for (step = r->first; step != NULL; )
 		{
-			tmp = tmp->next;
-		}
+			struct _Node* delme = step;
 
-		r->last = tmp;
+			step = step->next;
 
-		free(tmp->next);
-		tmp->next = NULL;
+			_ring_free_node(r, delme);
+		}
 	}
 
-	r->size -= 1;
+	r->first = NULL;
+	r->last = NULL;
+	r->size = 0;
+	r->dead = 0;
+	r->sweeping = false;
+	r->sweep = NULL;
+	r->finger = NULL;
 
 	ASSERT(ring_check_invariant(r));
 
-	return res;
+	return n;
 }
 
 
 // -----------------------------------------------------------------------------
 /**
- * Return the contend of a specified position. 
- * NULL if out of bounds or the contend was NULL in the first place. 
- * Complexity always O(i)
+ * Creates a ring holding the n elements of arr, in one allocation.
+ * Complexity always O(n)
  */
-cp ring_at (Ring r, uint64_t i)
+Ring ring_from_array(const cp* arr, uint64_t n)
 {
-	ASSERT(ring_check_invariant(r));
+	Ring res = ring_create();
 
-	if (i >= ring_size(r))
-		return NULL;
-	
-	struct _Node* step = r->first;
+	if (!n)
+		return res;
 
-	for(; i > 0; --i)
-		step = step->next;
+	res->arena = _arena_new(0);
+
+	struct _Node* block = _arena_chunk(res->arena, n);
+
+	for (uint64_t i = 0; i < n; ++i)
+	{
+		block[i].contend = arr[i];
+		block[i].next = block + i + 1;
+#ifdef RING_SOJOURN
+		block[i].enq = 0;
+#endif
+	}
+
+	block[n - 1].next = NULL;
 
-	return step->contend;
+	res->first = block;
+	res->last = block + n - 1;
+	res->size = n;
+
+	ASSERT(ring_check_invariant(res));
+
+	return res;
 }
 
 
 // -----------------------------------------------------------------------------
 /**
- * Extracts an element on a specified position.
- * NULL if out of bounds or the contend was NULL in the first place. 
- * Complexity always O(i)
+ * Starts a chunk by chunk view on the ring.
+ * Complexity always O(1)
  */
-cp ring_extract(Ring r, uint64_t i)
+void ring_view_init(Ring r, RingView* v)
 {
-	ASSERT(ring_check_invariant(r));
-
-	if (i >= ring_size(r))
-		return NULL;
-	
-	if(i == 0)
-	{
-		return ring_pop(r);
-	}
-	else
-	{
-		struct _Node* step = r->first;
-		struct _Node* delme; 
-		cp res;
-
-		for(; i > 1; --i)
-			step = step->next;
-
-		res = step->next->contend;
-		delme = step->next;
-		step->next = step->next->next;
+	v->next = r->first;
+}
 
-		if(delme == r->last)
-			r->last = step;
 
-		free(delme);
+// -----------------------------------------------------------------------------
+/**
+ * Fills v->chunk with the next up to RING_VIEW_CHUNK contend pointers.
+ * Complexity always O(RING_VIEW_CHUNK)
+ */
+uint64_t ring_view_next(RingView* v)
+{
+	uint64_t n = 0;
+	struct _Node* step = v->next;
 
-		r->size -= 1;
+	for (; step != NULL && n < RING_VIEW_CHUNK; step = step->next)
+		if (step->contend != RING_TOMBSTONE)
+			v->chunk[n++] = step->contend;
 
-		ASSERT(ring_check_invariant(r));
+	v->next = step;
 
-		return res; 
-	}
+	return n;
 }
 
 
 // -----------------------------------------------------------------------------
 /**
- * Inserts an element on a specified position.
- * Complexity always O(i)
+ * True if c is an element of the ring.
+ * Complexity O(n)
  */
-bool ring_insert_at(Ring r, cp c, uint64_t i)
+bool ring_find(Ring r, cp c)
 {
 	ASSERT(ring_check_invariant(r));
 
-	if (i > ring_size(r))
-		return false;
-
-	if (i == 0)
-	{
-		ring_push(r, c);
-	}
-	else if (i == ring_size(r))
-	{
-		ring_append(r, c);
-	}
-	else
-	{
-		struct _Node * step = r->first;
-
-		for(; i > 1; --i)
-			step = step->next;
+	uint64_t at;
 
-		step->next = _ring_create_node(step->next, c); 
+	return _ring_scan(r, c, true, &at) != 0;
+}
 
-		r->size += 1;
-	}
 
+// -----------------------------------------------------------------------------
+/**
+ * Position of the first occurence of c in the ring. -1 if there is none.
+ * Complexity O(n)
+ */
+int64_t ring_index_of(Ring r, cp c)
+{
 	ASSERT(ring_check_invariant(r));
 
-	return true;
+	uint64_t at;
+
+	return _ring_scan(r, c, true, &at) ? (int64_t)at : -1;
 }
 
+
 // -----------------------------------------------------------------------------
 /**
- * Removes a group of elements out of the ring and stores them in an other
- * Ring. del_func defines which element will be removed. Own userdata can 
- * be passed to the del_func with the last parameter.
+ * Number of elements equal to c.
  * Complexity always O(n)
  */
-Ring ring_remove_selected(Ring r, bool(*del_func)(cp c, void* ud), void* ud)
+uint64_t ring_count_eq(Ring r, cp c)
 {
 	ASSERT(ring_check_invariant(r));
 
-	Ring res = ring_create();
+	uint64_t at;
 
+	return _ring_scan(r, c, false, &at);
+}
 
-	while (!ring_is_empty(r))
-	{ 
-		if (del_func(ring_first(r), ud))
-			ring_append(res, ring_pop(r));
-		else
-			break;
-	}
 
-	// r->first guaranteed not in res
-	struct _Node* step = r->first;
+// -----------------------------------------------------------------------------
+/**
+ * Switches a ring into concurrent mode.
+ * Complexity always O(readers)
+ */
+bool ring_rcu_enable(Ring r, uint32_t readers)
+{
+	ASSERT(ring_check_invariant(r));
 
-	struct _Node* delme = NULL;
+	if (r->rcu)
+		return false;
 
-	while (step != NULL && step->next != NULL)
-	{
-		if (del_func(step->next->contend, ud))
-		{
-			ring_append(res, step->next->contend);
+	// readers don't know about tombstones
+	if (r->dead)
+		_ring_purge(r);
 
-			delme = step->next;
-			step->next = step->next->next;
+	struct _RingRcu* rcu = _smalloc(sizeof(*rcu));
 
-			if(delme == r->last)
-				r->last = step;
+	rcu->epoch = 1;
+	rcu->seq = 0;
+	rcu->readers = readers;
+	rcu->slots = calloc(readers ? readers : 1, sizeof(*rcu->slots));
 
-			free(delme);
+	if (!rcu->slots)
+		abort();
 
-			r->size -= 1;
-		}
-		else
-		{
-			step = step->next;
-		}
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		rcu->limbo[i] = NULL;
+		rcu->limbo_len[i] = 0;
+		rcu->limbo_cap[i] = 0;
 	}
 
-	ASSERT(ring_check_invariant(r));
+	r->rcu = rcu;
 
-	return res;
+	return true;
 }
 
 
 // -----------------------------------------------------------------------------
 /**
- * Concatenation of two rings. Don't use r1 & r2 after the call of this funktion.
- * Only the returned ring is supposed to be touched again.
- * Complexity always O(1)
+ * Reader side: takes a snapshot of the ring as it is right now.
+ * Complexity O(readers)
  */
-Ring ring_concat(Ring r1, Ring r2)
+bool ring_snapshot_take(Ring r, RingSnapshot* s)
 {
-	ASSERT(ring_check_invariant(r1));
-	ASSERT(ring_check_invariant(r2));
+	struct _RingRcu* rcu = r->rcu;
+	uint32_t i;
 
-	if(ring_is_empty(r1))
+	for (i = 0; i < rcu->readers; ++i)
 	{
-		free(r1);
-		return r2;
+		uint64_t idle = 0;
+		uint64_t e = __atomic_load_n(&rcu->epoch, __ATOMIC_SEQ_CST);
+
+		if (__atomic_compare_exchange_n(&rcu->slots[i].epoch, &idle, e, false,
+			__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			break;
 	}
-	else if(ring_is_empty(r2))
+
+	if (i == rcu->readers)
+		return false;
+
+	s->slot = i;
+
+	for (;;)
 	{
-		free(r2);
-		return r1;
-	}
+		uint64_t seq = __atomic_load_n(&rcu->seq, __ATOMIC_ACQUIRE);
 
-	r1->last->next = r2->first;
-	r1->last = r2->last;
-	r1->size += r2->size;
+		if (seq & 1)
+			continue;
 
-	free(r2);
+		s->next = __atomic_load_n(&r->first, __ATOMIC_RELAXED);
+		s->left = __atomic_load_n(&r->size, __ATOMIC_RELAXED);
 
-	ASSERT(ring_check_invariant(r1));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
 
-	return r1;
+		if (__atomic_load_n(&rcu->seq, __ATOMIC_RELAXED) == seq)
+			return true;
+	}
 }
 
+
 // -----------------------------------------------------------------------------
 /**
- * Distributes the contend of one ring over M other rings.
- * Complexity always O(n). A call with M=0 will result in M=1.
- * The input ring is still usable after this function.
- *
- * @return A ring containing M rings which comtain an nth part of the input ring.
+ * Reader side: stores the next element of the snapshot in *c.
+ * Complexity always O(1)
  */
-Ring ring_distribute(Ring r, uint64_t m)
+bool ring_snapshot_next(RingSnapshot* s, cp* c)
 {
-	ASSERT(ring_check_invariant(r));
-	if (!m)
-		m = 1;
-	
-	Ring * ring_vector = _smalloc(sizeof(Ring*) * m);
-	uint64_t i = 0;
+	if (!s->left || !s->next)
+		return false;
 
-	for(uint64_t i = 0; i < m; ++i)
-	{
-		ring_vector[i] = ring_create();
-	}
+	*c = s->next->contend;
+	s->left -= 1;
+	s->next = s->left ? __atomic_load_n(&s->next->next, __ATOMIC_ACQUIRE) : NULL;
 
-	for(ring_iterator(r))
-	{
-		ring_append(ring_vector[ i%m ], ring_index);
-		++i;
-	}
+	return true;
+}
 
 
-	Ring res = ring_create();
+// -----------------------------------------------------------------------------
+/**
+ * Reader side: gives the snapshot up.
+ * Complexity always O(1)
+ */
+void ring_snapshot_release(Ring r, RingSnapshot* s)
+{
+	__atomic_store_n(&r->rcu->slots[s->slot].epoch, 0, __ATOMIC_RELEASE);
 
-	for(uint64_t i = 0; i < m; ++i)
-	{
-		ring_append(res, ring_vector[i]);
-	}
-	
-	free(ring_vector);
+	s->next = NULL;
+	s->left = 0;
+}
 
-	return res;
+
+// -----------------------------------------------------------------------------
+/**
+ * Writer side: frees the removed nodes no reader can see anymore.
+ * Complexity O(readers + retired nodes)
+ */
+void ring_rcu_reclaim(Ring r)
+{
+	// two steps put the current epoch out of reach
+	if (r->rcu && _rcu_advance(r))
+		_rcu_advance(r);
 }
 
 
@@ -482,10 +3843,18 @@ char* ring_invariant(Ring r)
 	{
 		if(r->first || r->last)
 			return "WRONG STRUCTURE: Ring size = 0, but pointer are not NULL";
+
+		if(r->dead)
+			return "WRONG STRUCTURE: Ring size = 0, but tombstones left";
+
+		if(r->finger)
+			return "WRONG STRUCTURE: Ring size = 0, but finger is set";
 	}
 	else
 	{
 		uint64_t pos;
+		uint64_t dead = 0;
+		bool finger = r->finger == r->first;
 		struct _Node* tmp = r->first;
 
 		if(!r->first)
@@ -497,19 +3866,42 @@ char* ring_invariant(Ring r)
 			return "WRONG STRUCTURE: Last Link->Next is not NULL";
 
 
+		if(r->first->contend == RING_TOMBSTONE)
+			return "WRONG STRUCTURE: First Link is a tombstone";
+
 		for(pos = 1; tmp->next != NULL; ++pos)
 		{
-			if(pos > r->size)
+			if(pos > r->size + r->dead)
 				return "WRONG STRUCTURE: No NULL pointer found before size end reached";
 
 			tmp = tmp->next;
+
+			if(tmp == r->finger)
+			{
+				if(pos - dead != r->finger_pos)
+					return "WRONG STRUCTURE: Finger position != Counted Links";
+
+				finger = true;
+			}
+
+			if(tmp->contend == RING_TOMBSTONE)
+				dead += 1;
 		}
 
-		if(pos != r->size)
+		if(pos != r->size + r->dead)
 			return "WRONG STRUCTURE: Ring size != Counted Links";
 
+		if(dead != r->dead)
+			return "WRONG STRUCTURE: Ring dead != Counted tombstones";
+
 		if(tmp != r->last)
 			return "WRONG STRUCTURE: Last pointer != last Link";
+
+		if(r->finger && !finger)
+			return "WRONG STRUCTURE: Finger not in the ring";
+
+		if(r->finger == r->first && r->finger_pos)
+			return "WRONG STRUCTURE: Finger position != 0 on first Link";
 	}
 
 	return NULL;
@@ -11,6 +11,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -26,6 +27,33 @@ struct _Node
 	cp contend;
 	// The next Node  
 	struct _Node* next;
+#ifdef RING_SOJOURN
+	// Enqueue time in ns, set on rings with ring_sojourn_enable
+	uint64_t enq;
+#endif
+};
+
+// Node arena (opaque, see ring_arena_create)
+struct _RingArena;
+
+// Reader/writer state of the concurrent mode (opaque, see ring_rcu_enable)
+struct _RingRcu;
+
+// Capacity limit of a bounded ring (opaque, see ring_create_bounded)
+struct _RingBound;
+
+// Sojourn time statistics and CoDel state (opaque, see ring_sojourn_enable)
+struct _RingSojourn;
+
+// What happens to a new element when a bounded ring is full
+enum RingPolicy
+{
+	// the new element is refused
+	RING_REJECT,
+	// the first element is removed and handed to the drop callback
+	RING_DROP_OLDEST,
+	// the adding thread waits for room, thread safe queues only (ring_sync.h)
+	RING_BLOCK
 };
 
 // Base structure (Can't be opaque because of macro based interface)
@@ -34,11 +62,83 @@ struct _Ring
 	uint64_t size;
 	struct _Node* first;
 	struct _Node* last;
+	// Arena the nodes are taken from. NULL -> every node is malloc'd
+	struct _RingArena* arena;
+	// Concurrent mode state. NULL -> single threaded ring
+	struct _RingRcu* rcu;
+	// Capacity limit. NULL -> unbounded
+	struct _RingBound* bound;
+	// Sojourn times. NULL -> not tracked
+	struct _RingSojourn* sojourn;
+	// Tombstones still linked into the chain, see ring_tombstone
+	uint64_t dead;
+	// Incremental compaction: node to continue at, nodes per operation
+	struct _Node* sweep;
+	uint32_t sweep_budget;
+	// Tombstone ratio in percent that starts a compaction, 0 -> never
+	uint8_t dead_percent;
+	bool sweeping;
+	// Node of the last positional access and the live elements in front
+	// of it, ring_at/ring_extract/ring_insert_at continue from there
+	struct _Node* finger;
+	uint64_t finger_pos;
 }; 
 
 // Just 'Ring' for the main data structure
 typedef struct _Ring* Ring;
 
+// Handle for a node arena
+typedef struct _RingArena* RingArena;
+
+// Handle for the node of one element, see ring_tombstone
+typedef struct _Node* RingNode;
+
+// Contend of a node that was removed lazily (see ring_tombstone)
+extern char _ring_tombstone_mark;
+#define RING_TOMBSTONE ((cp)&_ring_tombstone_mark)
+
+// Consistent read-only view of a ring in concurrent mode
+struct _RingSnapshot
+{
+	// next node to visit
+	struct _Node* next;
+	// nodes left in the snapshot
+	uint64_t left;
+	// reader slot held by the snapshot
+	uint32_t slot;
+};
+
+typedef struct _RingSnapshot RingSnapshot;
+
+// Number of contend pointers a RingView hands out per step
+#define RING_VIEW_CHUNK 64
+
+// Chunk by chunk view on the contend of a ring, see ring_view_next
+struct _RingView
+{
+	// next node to copy
+	struct _Node* next;
+	// contend pointers of the current chunk
+	cp chunk[RING_VIEW_CHUNK];
+};
+
+typedef struct _RingView RingView;
+
+// Position in a ring for sequential access, see ring_cursor_init
+struct _RingCursor
+{
+	Ring ring;
+	// node of the current element, NULL past the end
+	struct _Node* node;
+	// position of the current element
+	uint64_t pos;
+};
+
+typedef struct _RingCursor RingCursor;
+
+// Streaming k-way merge (opaque, see ring_merge_open)
+typedef struct _RingMerge* RingMerge;
+
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -67,13 +167,280 @@ Ring ring_create(void);
 
 // -----------------------------------------------------------------------------
 /**
- * Destroys a Ring. All memory is released. Implement and provide a custom free()
+ * Creates a new Ring that holds at most cap elements. ring_push, ring_append
+ * and ring_insert_at apply the policy once it is full. ring_concat doesn't,
+ * the result keeps the limit of the first ring and refuses or drops on the
+ * next insert. RING_BLOCK needs a thread safe queue, see ring_sync_create.
+ * Complexity always O(1)
+ * @return NULL if cap is 0 or the policy is RING_BLOCK.
+ */
+Ring ring_create_bounded(uint64_t cap, enum RingPolicy policy);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Sets the callback that receives the elements dropped by RING_DROP_OLDEST,
+ * without one they are just removed.
+ * Complexity always O(1)
+ */
+void ring_on_drop(Ring r, void(*dropped)(cp c, void* ud), void* ud);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements dropped (RING_DROP_OLDEST) and refused (RING_REJECT)
+ * since the ring was created. 0 for unbounded rings.
+ * Complexity always O(1)
+ */
+uint64_t ring_drops(Ring r);
+uint64_t ring_rejects(Ring r);
+
+
+// Buckets of the sojourn histogram, bucket b counts times in [2^b, 2^(b+1)) ns
+#define RING_SOJOURN_BUCKETS 64
+
+// -----------------------------------------------------------------------------
+/**
+ * Starts tracking how long elements stay in r. Needs libring and the program
+ * built with -DRING_SOJOURN (make SOJOURN=1), which adds an enqueue time to
+ * every node. From then on new nodes are stamped and every ring_pop adds
+ * the time its element spent in the ring to a histogram. Elements added
+ * before, or by ring_from_array, have no stamp; they are neither counted
+ * nor judged by CoDel.
+ * Complexity always O(1)
+ * @return false if libring was built without RING_SOJOURN.
+ */
+bool ring_sojourn_enable(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies the sojourn histogram of r into counts, zeros if not tracked.
+ * Complexity always O(1)
+ */
+void ring_sojourn_histogram(Ring r, uint64_t counts[RING_SOJOURN_BUCKETS]);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Upper bound in ns of the sojourn time of the fraction q (0..1) of the
+ * popped elements, e.g. q = 0.99 for the 99th percentile. 0 without data.
+ * Complexity always O(1)
+ */
+uint64_t ring_sojourn_quantile(Ring r, double q);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Clears the sojourn histogram.
+ * Complexity always O(1)
+ */
+void ring_sojourn_reset(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Controlled delay (CoDel, RFC 8289) on ring_pop: once the sojourn time of
+ * the popped elements stays above target_ns for interval_ns, ring_pop drops
+ * elements at a rate growing with the square root of the drops, until the
+ * sojourn time falls below target_ns again. Dropped elements go to the
+ * callback (may be NULL), ring_pop returns the next element or NULL if
+ * none is left. target_ns 0 turns it off. Enables the sojourn tracking.
+ * Complexity always O(1)
+ * @return false if libring was built without RING_SOJOURN.
+ */
+bool ring_codel(Ring r, uint64_t target_ns, uint64_t interval_ns,
+	void(*dropped)(cp c, void* ud), void* ud);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements dropped by CoDel.
+ * Complexity always O(1)
+ */
+uint64_t ring_codel_drops(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a Ring. All memory is released, heap nodes possibly into the node
+ * cache first (see ring_node_cache). Implement and provide a custom free()
  * function to release the content elements.
- * Complexity always O(n)
+ * Complexity always O(n). O(1) for arena rings if free_contend is NULL.
  */
 void ring_destroy(Ring r, void(*free_contend)(cp));
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a Ring like ring_destroy, but the nodes are freed and
+ * free_contend is called on a background reclaimer thread, which is started
+ * with the first call. free_contend has to be safe to call from there.
+ * Rings whose arena is held by anything else are destroyed right away,
+ * which is O(1) for them without free_contend (see ring_destroy_step).
+ * That is other rings, and also the handle of ring_arena_create until
+ * ring_arena_destroy, since ring_create_in can hand out its nodes on
+ * another thread. Release the handle first to destroy the only ring of a
+ * user arena in the background.
+ * Complexity O(1) on the calling thread
+ */
+void ring_destroy_async(Ring r, void(*free_contend)(cp));
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a Ring in steps, for event loops: frees at most budget elements
+ * from the front per call. The ring stays a valid ring until the last step,
+ * that one releases it.
+ * Complexity O(budget)
+ * @return true once the ring is destroyed.
+ */
+bool ring_destroy_step(Ring r, void(*free_contend)(cp), uint64_t budget);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Blocks until the reclaimer thread has destroyed all rings handed to
+ * ring_destroy_async, e.g. before the process exits.
+ * Complexity O(pending nodes)
+ */
+void ring_destroy_wait(void);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a node arena. Nodes are carved out of chunks of chunk_nodes nodes
+ * (0 selects a default) and recycled through a free list instead of going
+ * back to malloc. The arena is not thread safe: all rings of one arena have
+ * to be used from one thread at a time.
+ * Complexity always O(1)
+ */
+RingArena ring_arena_create(uint64_t chunk_nodes);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a node arena whose chunks are mapped on huge pages: explicit ones
+ * (MAP_HUGETLB) if the system has some reserved, transparent ones
+ * (MADV_HUGEPAGE) otherwise, plain memory if both fail. One TLB entry then
+ * covers 2 MiB of nodes, which pays off for walks over large rings whose
+ * nodes are not in list order. chunk_nodes 0 selects one huge page per chunk.
+ * Complexity always O(1)
+ */
+RingArena ring_arena_create_huge(uint64_t chunk_nodes);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves a heap ring into a private huge page arena (see
+ * ring_arena_create_huge), the present nodes are compacted into it.
+ * Complexity always O(n)
+ * @return false if the ring uses an arena already.
+ */
+bool ring_hugepages(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a node arena whose chunks are placed on NUMA node (preferred
+ * policy through mbind, no libnuma needed). Rings walked by threads of that
+ * node then read local memory.
+ * Complexity always O(1)
+ * @return NULL if the node doesn't exist or is not allowed for the caller.
+ */
+RingArena ring_arena_create_numa(uint64_t chunk_nodes, int node);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the nodes of r, in list order, into a private arena on NUMA node
+ * (see ring_arena_create_numa). The old nodes go back to their arena or to
+ * malloc, nodes handles of r are invalid afterwards.
+ * Complexity always O(n)
+ * @return false if the node doesn't exist or is not allowed for the caller.
+ */
+bool ring_migrate(Ring r, int node);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * NUMA node the arena of r places its nodes on, -1 if it has no preference
+ * or r is a heap ring.
+ * Complexity always O(1)
+ */
+int ring_numa_node(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * NUMA node the memory at p (e.g. ring_index_node) is placed on, -1 if the
+ * kernel can't tell.
+ * Complexity always O(1)
+ */
+int ring_numa_locate(const void* p);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Gives up the handle returned by ring_arena_create. The memory is released
+ * as soon as the last ring using the arena is destroyed.
+ * Complexity O(chunks) if this was the last reference, else O(1)
+ */
+void ring_arena_destroy(RingArena a);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new Ring that takes its nodes from the arena a.
+ * Rings of different arenas (or heap rings) may be concatenated freely, the
+ * arenas are merged in that case.
+ * Complexity always O(1)
+ */
+Ring ring_create_in(RingArena a);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the arena of a ring. NULL if the nodes live on the heap.
+ * Complexity always O(1)
+ */
+RingArena ring_arena(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Releases every chunk of the arena that holds no live node anymore.
+ * Use it after ring_compact to give the old, fragmented chunks back.
+ * Complexity O(f * log(chunks)) with f free nodes in the arena
+ * @return Number of bytes released.
+ */
+uint64_t ring_arena_trim(RingArena a);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Switches the node cache on or off, it is on by default. Freed heap nodes
+ * go to a magazine of the calling thread, full magazines are exchanged with
+ * a global depot in batches. Nodes appended on one thread and popped on
+ * another travel back without malloc or free and take the depot lock only
+ * once per magazine. A thread hands its magazines to the depot at exit, the
+ * depot and the magazines of the thread calling exit() or returning from
+ * main are freed by an atexit handler. ring_node_cache_trim releases them
+ * earlier. Switching the cache off keeps what it holds until then.
+ * Complexity always O(1)
+ */
+void ring_node_cache(bool on);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Frees the nodes cached by the calling thread and those in the depot.
+ * Complexity O(cached nodes)
+ * @return Number of bytes released.
+ */
+uint64_t ring_node_cache_trim(void);
+
+
 // -----------------------------------------------------------------------------
 /**
  * Returns the first element. NULL if the ring is empty.
@@ -85,25 +452,38 @@ void ring_destroy(Ring r, void(*free_contend)(cp));
 // -----------------------------------------------------------------------------
 /**
  * Returns the last element. NULL if the ring is empty.
+ * Complexity O(1), O(n) if the last node is a tombstone
+ */
+#define ring_last(r) ( (ring_is_empty(r) ) ? NULL : \
+		(r->last->contend != RING_TOMBSTONE) ? r->last->contend : \
+		ring_at(r, ring_size(r) - 1) )
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the node of the element added last by ring_append. Use it right
+ * after the append to keep a handle for ring_tombstone.
  * Complexity always O(1)
  */
-#define ring_last(r) ( (ring_is_empty(r) ) ? NULL : r->last->contend )
+#define ring_last_node(r) (r->last)
 
 
 // -----------------------------------------------------------------------------
 /**
  * Adds one element at the beginning of the ring.
  * Complexity always O(1)
+ * @return false if a full bounded ring refused it.
  */
-void ring_push(Ring r, cp c);
+bool ring_push(Ring r, cp c);
 
 
 // -----------------------------------------------------------------------------
 /**
  * Adds one element at the end of the ring.
  * Complexity always O(1)
+ * @return false if a full bounded ring refused it.
  */
-void ring_append(Ring r, cp c);
+bool ring_append(Ring r, cp c);
 
 
 // -----------------------------------------------------------------------------
@@ -159,17 +539,35 @@ cp ring_chop(Ring r);
  * Complexity O(n) if no break or goto is used.
  */
 #define ring_iterator(r) struct _Node* _iterat_ = r->first; \
-		_iterat_ != NULL; _iterat_ = _iterat_->next
+		_iterat_ != NULL; _iterat_ = _ring_live(_iterat_->next)
 
 
 #define ring_index (_iterat_->contend)
 
+// Node of the current element, a handle for ring_tombstone
+#define ring_index_node (_iterat_)
+
+
+// -----------------------------------------------------------------------------
+/**
+ * First node from n on that is not a tombstone. Used by ring_iterator.
+ */
+static inline struct _Node* _ring_live(struct _Node* n)
+{
+	while (n != NULL && n->contend == RING_TOMBSTONE)
+		n = n->next;
+
+	return n;
+}
+
 
 // -----------------------------------------------------------------------------
 /**
  * Return the contend of a specified position. 
  * NULL if out of bounds or the contend was NULL in the first place. 
- * Complexity always O(i)
+ * The ring remembers the node (finger), the next ring_at, ring_extract or
+ * ring_insert_at at the same or a later position continues from there.
+ * Complexity O(i), O(i - j) after an access at position j <= i
  */
 cp ring_at (Ring r, uint64_t i);
 
@@ -178,7 +576,7 @@ cp ring_at (Ring r, uint64_t i);
 /**
  * Extracts an element on a specified position.
  * NULL if out of bounds or the contend was NULL in the first place. 
- * Complexity always O(i)
+ * Complexity O(i), O(i - j) after an access at position j < i
  */
 cp ring_extract(Ring r, uint64_t i);
 
@@ -186,11 +584,104 @@ cp ring_extract(Ring r, uint64_t i);
 // -----------------------------------------------------------------------------
 /**
  * Inserts an element on a specified position.
- * Complexity always O(i)
+ * Complexity O(i), O(i - j) after an access at position j < i
+ * @return false if i is out of bounds or a full bounded ring refused it.
  */
 bool ring_insert_at(Ring r, cp c, uint64_t i);
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Moves the first k elements to the end, in order. Only links change, no
+ * node is allocated or freed, so ring_rotate(r, 1) is a cheap replacement
+ * for ring_append(r, ring_pop(r)) in round robin loops.
+ * Complexity O(k % ring_size(r)), O(1) for k = 1
+ */
+void ring_rotate(Ring r, uint64_t k);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Rotates the ring until the element of node n is the first one. n has to
+ * be a live node of r, see ring_index_node.
+ * Complexity O(i) with i the position of n
+ */
+void ring_rotate_to(Ring r, RingNode n);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Puts the cursor c on the first element of r. Walk the ring like this:
+ *
+ *	RingCursor c;
+ *
+ *	for (ring_cursor_init(r, &c); ring_cursor_valid(&c); ring_cursor_advance(&c))
+ *		if (drop(ring_cursor_get(&c)))
+ *			...
+ *
+ * Changes through the cursor keep it valid, any other change of the ring
+ * invalidates it.
+ * Complexity always O(1)
+ */
+void ring_cursor_init(Ring r, RingCursor* c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * True while the cursor stands on an element.
+ */
+#define ring_cursor_valid(c) ((c)->node != NULL)
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Position of the current element.
+ */
+#define ring_cursor_pos(c) ((c)->pos)
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Contend of the current element. NULL past the end.
+ */
+#define ring_cursor_get(c) ( ring_cursor_valid(c) ? (c)->node->contend : NULL )
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Replaces the contend of the current element. The cursor has to be valid.
+ */
+#define ring_cursor_set(c, v) ((c)->node->contend = (v))
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the cursor to the next element.
+ * Complexity always O(1)
+ * @return false if the cursor went past the end.
+ */
+bool ring_cursor_advance(RingCursor* c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Inserts v behind the current element, the cursor stays where it is.
+ * A full bounded ring refuses the element, whatever its policy.
+ * Complexity always O(1)
+ * @return false if the cursor is past the end or the ring is full.
+ */
+bool ring_cursor_insert_after(RingCursor* c, cp v);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the element behind the current one, the cursor stays where it is.
+ * NULL if there is none or the contend was NULL in the first place.
+ * Complexity always O(1)
+ */
+cp ring_cursor_remove_after(RingCursor* c);
+
+
 // -----------------------------------------------------------------------------
 /**
  * Removes a group of elements out of the ring and stores them in another
@@ -201,6 +692,47 @@ bool ring_insert_at(Ring r, cp c, uint64_t i);
 Ring ring_remove_selected(Ring r, bool(*del_func)(cp c, void* ud), void* ud);
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Removes the element of node n lazily: the node stays linked as a
+ * tombstone that ring_iterator, ring_pop, ring_at and the other functions
+ * skip, ring_size counts live elements only. n has to be a live node of r,
+ * taken from ring_index_node or ring_last_node. Once the tombstones make up
+ * the threshold of ring_tombstone_policy, they are unlinked and freed.
+ * Not available in concurrent mode. Handles of other elements stay valid
+ * until their element is removed or the ring is compacted.
+ * Complexity O(1), plus the compaction if the threshold is crossed
+ * @return The contend of the removed element.
+ */
+cp ring_tombstone(Ring r, RingNode n);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Sets when tombstones are compacted: as soon as they are percent % of the
+ * nodes (default 50, 0 leaves it to ring_purge). With budget 0 all of them
+ * are removed at once, otherwise every ring_push, ring_append, ring_pop and
+ * ring_tombstone checks up to budget nodes until the pass is done.
+ * Complexity always O(1)
+ */
+void ring_tombstone_policy(Ring r, uint8_t percent, uint32_t budget);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Unlinks and frees all tombstones now.
+ * Complexity always O(n)
+ */
+void ring_purge(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of tombstones still linked into the ring.
+ */
+#define ring_dead(r) (r->dead)
+
+
 // -----------------------------------------------------------------------------
 /**
  * Concatenation of two rings. Don't use r1 & r2 after the call of this function.
@@ -210,6 +742,72 @@ Ring ring_remove_selected(Ring r, bool(*del_func)(cp c, void* ud), void* ud);
 Ring ring_concat(Ring r1, Ring r2);
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Concatenation of k rings, in array order. Don't use any of the input rings
+ * after the call of this function.
+ * Complexity always O(k)
+ */
+Ring ring_concat_n(Ring* rings, uint64_t k);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Merges k rings sorted by cmp (negative, zero or positive like strcmp)
+ * into one sorted ring. The nodes are relinked, none is allocated or freed;
+ * equal elements keep the order of the input rings. Tombstones are purged.
+ * Don't use any of the input rings after the call of this function.
+ * Complexity O(n log k)
+ */
+Ring ring_merge_sorted(Ring* rings, uint64_t k, int(*cmp)(cp a, cp b));
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Starts a merge of k rings sorted by cmp that hands out one element per
+ * ring_merge_next. The rings stay owned by the caller and lose the elements
+ * handed out; they must not be changed otherwise until ring_merge_close.
+ * The array rings is copied.
+ * Complexity O(k)
+ */
+RingMerge ring_merge_open(Ring* rings, uint64_t k, int(*cmp)(cp a, cp b));
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Pops the smallest first element of all rings of the merge. NULL once all
+ * rings are empty.
+ * Complexity O(log k)
+ */
+cp ring_merge_next(RingMerge m);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Ends the merge, the rings keep the elements not handed out.
+ * Complexity always O(1)
+ */
+void ring_merge_close(RingMerge m);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Splits the ring before position i. r keeps the first i elements, the
+ * returned ring holds the rest. No node is copied or allocated.
+ * NULL if i is out of bounds.
+ * Complexity always O(i)
+ */
+Ring ring_split_at(Ring r, uint64_t i);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Splits the ring in two halves, r keeps the first ring_size(r) / 2 elements.
+ * Complexity always O(n)
+ */
+#define ring_split_half(r) ring_split_at(r, ring_size(r) / 2)
+
+
 // -----------------------------------------------------------------------------
 /**
  * Distributes the contend of one ring over N other rings.
@@ -219,6 +817,155 @@ Ring ring_concat(Ring r1, Ring r2);
 Ring ring_distribute(Ring r, uint64_t n);
 
 
+// -----------------------------------------------------------------------------
+/**
+ * Moves every element of r to the end of buckets[key(c, ud) % k], in one
+ * pass and in order, so each bucket keeps the relative order of r (stable,
+ * the step of an LSD radix sort). The nodes are relinked, none is allocated.
+ * Tombstones are dropped on the way. A full bounded bucket applies its
+ * policy like ring_append: RING_DROP_OLDEST frees its first element,
+ * RING_REJECT refuses and the element stays in r, in order. Without such
+ * refusals r is empty afterwards.
+ * Complexity always O(n)
+ */
+void ring_bucketize(Ring r, Ring* buckets, uint64_t k, uint64_t(*key)(cp c, void* ud), void* ud);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves all nodes into one contiguous block, in list order. Sequential
+ * walks over the ring become prefetcher friendly again. A heap ring gets a
+ * private arena for that block, an arena ring keeps its arena and leaves the
+ * old nodes on the free list (see ring_arena_trim).
+ * Complexity always O(n)
+ */
+void ring_compact(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Switches a ring into concurrent mode: one writer thread keeps using
+ * ring_push, ring_append and ring_pop, while up to 'readers' other threads
+ * iterate consistent snapshots. Nodes removed by the writer are only freed
+ * once no snapshot can reach them anymore (epoch based reclamation).
+ * Readers never block the writer. All other modifying functions need the
+ * readers to be gone. Call before the readers start. 
+ * Complexity always O(readers)
+ * @return false if the ring is in concurrent mode already.
+ */
+bool ring_rcu_enable(Ring r, uint32_t readers);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Reader side: takes a snapshot of the ring as it is right now. Lock free,
+ * retries only while the writer is in the middle of an operation.
+ * Complexity O(readers)
+ * @return false if all reader slots are in use.
+ */
+bool ring_snapshot_take(Ring r, RingSnapshot* s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Reader side: stores the next element of the snapshot in *c.
+ * Complexity always O(1)
+ * @return false at the end of the snapshot.
+ */
+bool ring_snapshot_next(RingSnapshot* s, cp* c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Reader side: gives the snapshot up. The nodes it saw may be freed now.
+ * Complexity always O(1)
+ */
+void ring_snapshot_release(Ring r, RingSnapshot* s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Writer side: frees the removed nodes no reader can see anymore. Happens
+ * on its own every few removals, call it when the writer goes idle.
+ * Complexity O(readers + retired nodes)
+ */
+void ring_rcu_reclaim(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies the contend of the ring in order into out, which needs room for
+ * ring_size(r) elements. With consume the nodes are released in the same
+ * pass and the ring is empty afterwards.
+ * Complexity always O(n)
+ * @return Number of elements written.
+ */
+uint64_t ring_to_array(Ring r, cp* out, bool consume);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a ring holding the n elements of arr. All nodes come from one
+ * contiguous allocation (a private arena, see ring_compact).
+ * Complexity always O(n)
+ */
+Ring ring_from_array(const cp* arr, uint64_t n);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Starts a chunk by chunk view on the ring. The same rules as for
+ * ring_iterator apply, don't add or remove elements while the view is used.
+ *
+ *	RingView v;
+ *	uint64_t n;
+ *
+ *	ring_view_init(r, &v);
+ *
+ *	while ((n = ring_view_next(&v)))
+ *		process(v.chunk, n);
+ *
+ * Complexity always O(1)
+ */
+void ring_view_init(Ring r, RingView* v);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Fills v->chunk with the next up to RING_VIEW_CHUNK contend pointers.
+ * Complexity always O(RING_VIEW_CHUNK)
+ * @return Number of pointers in the chunk, 0 at the end of the ring.
+ */
+uint64_t ring_view_next(RingView* v);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * True if c is an element of the ring. On arena rings (see ring_compact)
+ * runs of contiguous nodes are compared several at a time with SSE2/AVX2,
+ * picked at runtime. Heap rings are walked node by node.
+ * Complexity O(n)
+ */
+bool ring_find(Ring r, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Position of the first occurence of c in the ring. -1 if there is none.
+ * Same search as ring_find.
+ * Complexity O(n)
+ */
+int64_t ring_index_of(Ring r, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements equal to c. Same search as ring_find.
+ * Complexity always O(n)
+ */
+uint64_t ring_count_eq(Ring r, cp c);
+
+
 // -----------------------------------------------------------------------------
 /**
  * Ring Invariant check.
@@ -0,0 +1,275 @@
+/**
+ * Buffer chain on top of Ring for gather/scatter socket I/O.
+ */
+
+#define _XOPEN_SOURCE 700
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+#include "ring_bufchain.h"
+#include "ring_intern.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+	#define IOV_MAX 1024
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+struct _RingBufChain
+{
+	// RingBuf* in stream order
+	Ring segs;
+	// see ring_bufchain_pending
+	uint64_t pending;
+	void (*release)(RingBuf* b, void* ud);
+	void* ud;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Releases the first segment.
+ */
+static inline void _bufchain_release_first(RingBufChain ch)
+{
+	RingBuf* b = ring_pop(ch->segs);
+
+	if (ch->release)
+		ch->release(b, ch->ud);
+
+	free(b);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// EXTERN INTERFACE FUNCTIONS
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a buffer chain.
+ * Complexity always O(1)
+ */
+RingBufChain ring_bufchain_create(void(*release)(RingBuf* b, void* ud), void* ud)
+{
+	RingBufChain res = _smalloc(sizeof(*res));
+
+	res->segs = ring_create();
+	res->pending = 0;
+	res->release = release;
+	res->ud = ud;
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys the chain, release is called for all remaining segments.
+ * Complexity always O(n)
+ */
+void ring_bufchain_destroy(RingBufChain ch)
+{
+	while (!ring_is_empty(ch->segs))
+		_bufchain_release_first(ch);
+
+	ring_destroy(ch->segs, NULL);
+	free(ch);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Appends a segment of len bytes.
+ * Complexity always O(1)
+ */
+void ring_bufchain_add(RingBufChain ch, void* ptr, size_t len)
+{
+	RingBuf* b = _smalloc(sizeof(*b));
+
+	b->ptr = ptr;
+	b->len = len;
+	b->offset = 0;
+
+	ring_append(ch->segs, b);
+	ch->pending += len;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of segments in the chain.
+ * Complexity always O(1)
+ */
+uint64_t ring_bufchain_segments(RingBufChain ch)
+{
+	return ring_size(ch->segs);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Bytes not yet sent (sending), or free space left (receiving).
+ * Complexity always O(1)
+ */
+uint64_t ring_bufchain_pending(RingBufChain ch)
+{
+	return ch->pending;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Sends the pending bytes of up to IOV_MAX segments with one writev.
+ * Complexity O(IOV_MAX)
+ */
+ssize_t ring_bufchain_writev(RingBufChain ch, int fd)
+{
+	struct iovec iov[IOV_MAX];
+	int n = 0;
+
+	// empty segments in front never go out with a write, release them here
+	while (!ring_is_empty(ch->segs))
+	{
+		RingBuf* b = ring_first(ch->segs);
+
+		if (b->offset != b->len)
+			break;
+
+		_bufchain_release_first(ch);
+	}
+
+	for (ring_iterator(ch->segs))
+	{
+		RingBuf* b = ring_index;
+
+		if (n == IOV_MAX)
+			break;
+
+		if (b->offset == b->len)
+			continue;
+
+		iov[n].iov_base = (char*)b->ptr + b->offset;
+		iov[n].iov_len = b->len - b->offset;
+		++n;
+	}
+
+	if (!n)
+		return 0;
+
+	ssize_t res = writev(fd, iov, n);
+
+	if (res <= 0)
+		return res;
+
+	size_t left = res;
+
+	ch->pending -= res;
+
+	// drop what went out, the first segment left over keeps its offset
+	while (!ring_is_empty(ch->segs))
+	{
+		RingBuf* b = ring_first(ch->segs);
+		size_t rest = b->len - b->offset;
+
+		if (rest > left)
+		{
+			b->offset += left;
+			break;
+		}
+
+		left -= rest;
+		_bufchain_release_first(ch);
+	}
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Receives into the free space of up to IOV_MAX segments with one readv.
+ * Complexity O(IOV_MAX + filled segments)
+ */
+ssize_t ring_bufchain_readv(RingBufChain ch, int fd)
+{
+	struct iovec iov[IOV_MAX];
+	int n = 0;
+
+	for (ring_iterator(ch->segs))
+	{
+		RingBuf* b = ring_index;
+
+		if (n == IOV_MAX)
+			break;
+
+		if (b->offset == b->len)
+			continue;
+
+		iov[n].iov_base = (char*)b->ptr + b->offset;
+		iov[n].iov_len = b->len - b->offset;
+		++n;
+	}
+
+	// 0 would read like end of file
+	if (!n)
+		return errno = ENOBUFS, -1;
+
+	ssize_t res = readv(fd, iov, n);
+
+	if (res <= 0)
+		return res;
+
+	size_t left = res;
+
+	ch->pending -= res;
+
+	for (ring_iterator(ch->segs))
+	{
+		RingBuf* b = ring_index;
+		size_t room = b->len - b->offset;
+
+		if (!left)
+			break;
+
+		if (room > left)
+			room = left;
+
+		b->offset += room;
+		left -= room;
+	}
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the first segment if it holds received data.
+ * Complexity always O(1)
+ */
+bool ring_bufchain_take(RingBufChain ch, RingBuf* b)
+{
+	RingBuf* first = ring_first(ch->segs);
+
+	if (!first || !first->offset)
+		return false;
+
+	*b = *first;
+	ch->pending -= first->len - first->offset;
+
+	free(ring_pop(ch->segs));
+
+	return true;
+}
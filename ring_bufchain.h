@@ -0,0 +1,129 @@
+/**
+ * Buffer chain on top of Ring for gather/scatter socket I/O. A chain holds
+ * segments {ptr, len, offset}. Sending: ring_bufchain_writev writes as many
+ * pending bytes as the fd takes with one syscall and releases the segments
+ * that went out completely. Receiving: ring_bufchain_readv fills the free
+ * space of the segments with one syscall, ring_bufchain_take hands filled
+ * segments out. No byte is copied by the chain.
+ */
+
+#ifndef _RING_BUFCHAIN_H_
+#define _RING_BUFCHAIN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "ring.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// One segment
+struct _RingBuf
+{
+	// start of the buffer
+	void* ptr;
+	// data length when sending, capacity when receiving
+	size_t len;
+	// bytes sent / received so far
+	size_t offset;
+};
+
+typedef struct _RingBuf RingBuf;
+
+// Buffer chain (opaque)
+typedef struct _RingBufChain* RingBufChain;
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE 
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a buffer chain. release is called for every segment the chain
+ * is done with (sent completely, or dropped by ring_bufchain_destroy) and
+ * may be NULL. ud is passed through.
+ * Complexity always O(1)
+ */
+RingBufChain ring_bufchain_create(void(*release)(RingBuf* b, void* ud), void* ud);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys the chain, release is called for all remaining segments.
+ * Complexity always O(n)
+ */
+void ring_bufchain_destroy(RingBufChain ch);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Appends a segment of len bytes. For sending it holds the data, for
+ * receiving it is free space. The buffer must stay valid until released.
+ * Complexity always O(1)
+ */
+void ring_bufchain_add(RingBufChain ch, void* ptr, size_t len);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of segments in the chain.
+ * Complexity always O(1)
+ */
+uint64_t ring_bufchain_segments(RingBufChain ch);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Bytes not yet sent (sending), or free space left (receiving).
+ * Complexity always O(1)
+ */
+uint64_t ring_bufchain_pending(RingBufChain ch);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Sends the pending bytes of up to IOV_MAX segments with one writev.
+ * Partially sent segments keep their new offset, completely sent ones are
+ * released in the same pass. Empty segments in front are released first,
+ * also when nothing else is pending.
+ * Complexity O(IOV_MAX)
+ * @return Bytes written, 0 if nothing is pending, -1 with errno set if
+ * writev failed.
+ */
+ssize_t ring_bufchain_writev(RingBufChain ch, int fd);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Receives into the free space of up to IOV_MAX segments with one readv.
+ * Complexity O(IOV_MAX + filled segments)
+ * @return Bytes read, 0 on end of file, -1 with errno set if readv failed.
+ * -1 with errno ENOBUFS if the chain has no free space, add or take
+ * segments first.
+ */
+ssize_t ring_bufchain_readv(RingBufChain ch, int fd);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the first segment if it holds received data and stores it in *b,
+ * b->offset bytes are valid. The segment is the callers again, release is
+ * not called for it.
+ * Complexity always O(1)
+ * @return false if the first segment is empty or the chain is.
+ */
+bool ring_bufchain_take(RingBufChain ch, RingBuf* b);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
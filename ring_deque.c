@@ -0,0 +1,701 @@
+/**
+ * Ring with a block deque layout, see ring_deque.h
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+#include "ring_deque.h"
+#include "ring_intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// DEBUGGING
+#if defined(INVARIANT_CHECKS) || defined(DEBUG)
+	#include <stdio.h>
+	bool ring_check_invariant(Ring r);
+#endif
+
+#define B RING_DEQUE_BLOCK
+
+// Block pointers of the first map
+#define RING_DEQUE_MAP_INITIAL 8
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Replaces the map by one with free block pointers on both sides of the
+ * used blocks, twice as large if more than half of it is in use. Only the
+ * block pointers move, the blocks stay where they are.
+ * Complexity O(map size)
+ */
+static void _deque_room(Ring r)
+{
+	ASSERT(r->size || !r->map, "empty rings are centred in their map");
+
+	uint64_t first = r->head / B;
+	uint64_t used = r->size ? (r->head + r->size - 1) / B - first + 1 : 0;
+	uint64_t cap = r->map_size ? r->map_size : RING_DEQUE_MAP_INITIAL;
+
+	while (used * 2 + 2 > cap)
+		cap *= 2;
+
+	cp** map = _smalloc(cap * sizeof(*map));
+	uint64_t off = (cap - used) / 2;
+
+	memset(map, 0, cap * sizeof(*map));
+
+	if (used)
+	{
+		memcpy(map + off, r->map + first, used * sizeof(*map));
+		r->head = off * B + r->head % B;
+	}
+	else
+	{
+		r->head = cap / 2 * B + B / 2;
+	}
+
+	free(r->map);
+
+	r->map = map;
+	r->map_size = cap;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Allocates block b if it isn't there yet.
+ */
+static inline void _deque_block(Ring r, uint64_t b)
+{
+	if (!r->map[b])
+		r->map[b] = _smalloc(B * sizeof(cp));
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * The last element of block b is gone and the ring is empty. The block is
+ * kept in the middle of the map, so push and append both have room again.
+ */
+static void _deque_emptied(Ring r, uint64_t b)
+{
+	uint64_t c = r->map_size / 2;
+	cp* blk = r->map[b];
+
+	r->map[b] = NULL;
+	r->map[c] = blk;
+	r->head = c * B + B / 2;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Frees all blocks and the map, r is a fresh empty ring afterwards.
+ */
+static void _deque_clear(Ring r)
+{
+	for (uint64_t b = 0; b < r->map_size; ++b)
+		free(r->map[b]);
+
+	free(r->map);
+
+	r->map = NULL;
+	r->map_size = 0;
+	r->head = 0;
+	r->size = 0;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Drops elements from the end until n are left.
+ */
+static void _deque_truncate(Ring r, uint64_t n)
+{
+	while (r->size > n)
+		ring_chop(r);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements equal to c from position 0 on. With first the scan
+ * stops at the first one, *pos is its position then.
+ */
+static uint64_t _deque_scan(Ring r, cp c, bool first, uint64_t* pos)
+{
+	uint64_t count = 0;
+
+	for (uint64_t done = 0; done < r->size; )
+	{
+		uint64_t at = r->head + done;
+		uint64_t n = B - at % B;
+		cp* blk = r->map[at / B] + at % B;
+
+		if (n > r->size - done)
+			n = r->size - done;
+
+		if (first)
+		{
+			for (uint64_t k = 0; k < n; ++k)
+				if (blk[k] == c)
+				{
+					*pos = done + k;
+					return 1;
+				}
+		}
+		else
+		{
+			for (uint64_t k = 0; k < n; ++k)
+				count += blk[k] == c;
+		}
+
+		done += n;
+	}
+
+	return count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// EXTERN INTERFACE FUNCTIONS
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new Ring.
+ * Complexity always O(1)
+ */
+Ring ring_create(void)
+{
+	Ring res = _smalloc(sizeof(*res));
+
+	res->size = 0;
+	res->head = 0;
+	res->map = NULL;
+	res->map_size = 0;
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys the ring.
+ * Complexity always O(n / RING_DEQUE_BLOCK), O(n) with free_contend
+ */
+void ring_destroy(Ring r, void(*free_contend)(cp))
+{
+	ASSERT(ring_check_invariant(r));
+
+	if (free_contend)
+		for (ring_iterator(r))
+			free_contend(ring_index);
+
+	_deque_clear(r);
+	free(r);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the beginning of the ring.
+ * Complexity amortized O(1)
+ */
+bool ring_push(Ring r, cp c)
+{
+	if (!r->head)
+		_deque_room(r);
+
+	r->head -= 1;
+	r->size += 1;
+
+	_deque_block(r, r->head / B);
+	_ring_slot(r, 0) = c;
+
+	ASSERT(ring_check_invariant(r));
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the end of the ring.
+ * Complexity amortized O(1)
+ */
+bool ring_append(Ring r, cp c)
+{
+	if (r->head + r->size == r->map_size * B)
+		_deque_room(r);
+
+	_deque_block(r, (r->head + r->size) / B);
+	_ring_slot(r, r->size) = c;
+
+	r->size += 1;
+
+	ASSERT(ring_check_invariant(r));
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element of the ring.
+ * Complexity always O(1)
+ */
+cp ring_pop(Ring r)
+{
+	if (ring_is_empty(r))
+		return NULL;
+
+	uint64_t b = r->head / B;
+	cp res = _ring_slot(r, 0);
+
+	r->head += 1;
+	r->size -= 1;
+
+	if (!r->size)
+	{
+		_deque_emptied(r, b);
+	}
+	else if (r->head % B == 0)
+	{
+		free(r->map[b]);
+		r->map[b] = NULL;
+	}
+
+	ASSERT(ring_check_invariant(r));
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the last element of the ring.
+ * Complexity always O(1)
+ */
+cp ring_chop(Ring r)
+{
+	if (ring_is_empty(r))
+		return NULL;
+
+	uint64_t at = r->head + r->size - 1;
+	cp res = _ring_slot(r, r->size - 1);
+
+	r->size -= 1;
+
+	if (!r->size)
+	{
+		_deque_emptied(r, at / B);
+	}
+	else if (at % B == 0)
+	{
+		free(r->map[at / B]);
+		r->map[at / B] = NULL;
+	}
+
+	ASSERT(ring_check_invariant(r));
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Return the contend of a specified position.
+ * Complexity always O(1)
+ */
+cp ring_at(Ring r, uint64_t i)
+{
+	if (i >= ring_size(r))
+		return NULL;
+
+	return _ring_slot(r, i);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Extracts an element on a specified position.
+ * Complexity O(min(i, n - i))
+ */
+cp ring_extract(Ring r, uint64_t i)
+{
+	if (i >= ring_size(r))
+		return NULL;
+
+	cp res = _ring_slot(r, i);
+
+	if (i < ring_size(r) / 2)
+	{
+		for (uint64_t k = i; k > 0; --k)
+			_ring_slot(r, k) = _ring_slot(r, k - 1);
+
+		ring_pop(r);
+	}
+	else
+	{
+		for (uint64_t k = i; k + 1 < ring_size(r); ++k)
+			_ring_slot(r, k) = _ring_slot(r, k + 1);
+
+		ring_chop(r);
+	}
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Inserts an element on a specified position.
+ * Complexity O(min(i, n - i))
+ */
+bool ring_insert_at(Ring r, cp c, uint64_t i)
+{
+	if (i > ring_size(r))
+		return false;
+
+	if (i == 0)
+		return ring_push(r, c);
+
+	if (i == ring_size(r))
+		return ring_append(r, c);
+
+	if (i < ring_size(r) / 2)
+	{
+		ring_push(r, ring_first(r));
+
+		for (uint64_t k = 1; k < i; ++k)
+			_ring_slot(r, k) = _ring_slot(r, k + 1);
+	}
+	else
+	{
+		ring_append(r, ring_last(r));
+
+		for (uint64_t k = ring_size(r) - 2; k > i; --k)
+			_ring_slot(r, k) = _ring_slot(r, k - 1);
+	}
+
+	_ring_slot(r, i) = c;
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the first k elements to the end, in order.
+ * Complexity O(min(k, n - k))
+ */
+void ring_rotate(Ring r, uint64_t k)
+{
+	if (ring_size(r) < 2 || !(k %= ring_size(r)))
+		return;
+
+	if (k <= ring_size(r) / 2)
+	{
+		while (k--)
+			ring_append(r, ring_pop(r));
+	}
+	else
+	{
+		for (k = ring_size(r) - k; k; --k)
+			ring_push(r, ring_chop(r));
+	}
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes all elements for which del_func returns true.
+ * Complexity always O(n)
+ */
+Ring ring_remove_selected(Ring r, bool(*del_func)(cp c, void* ud), void* ud)
+{
+	Ring res = ring_create();
+	uint64_t keep = 0;
+
+	for (uint64_t k = 0; k < ring_size(r); ++k)
+	{
+		cp c = _ring_slot(r, k);
+
+		if (del_func(c, ud))
+		{
+			ring_append(res, c);
+		}
+		else
+		{
+			_ring_slot(r, keep) = c;
+			keep += 1;
+		}
+	}
+
+	_deque_truncate(r, keep);
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Concatenation of two rings.
+ * Complexity O(min(n1, n2))
+ */
+Ring ring_concat(Ring r1, Ring r2)
+{
+	ASSERT(ring_check_invariant(r1));
+	ASSERT(ring_check_invariant(r2));
+
+	if (ring_size(r1) >= ring_size(r2))
+	{
+		for (ring_iterator(r2))
+			ring_append(r1, ring_index);
+
+		ring_destroy(r2, NULL);
+		return r1;
+	}
+
+	for (uint64_t k = ring_size(r1); k > 0; --k)
+		ring_push(r2, _ring_slot(r1, k - 1));
+
+	ring_destroy(r1, NULL);
+	return r2;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Concatenation of k rings, in array order.
+ * Complexity O(n)
+ */
+Ring ring_concat_n(Ring* rings, uint64_t k)
+{
+	if (!k)
+		return ring_create();
+
+	Ring res = rings[0];
+
+	for (uint64_t i = 1; i < k; ++i)
+		res = ring_concat(res, rings[i]);
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Splits the ring before position i.
+ * Complexity O(min(i, n - i))
+ */
+Ring ring_split_at(Ring r, uint64_t i)
+{
+	ASSERT(ring_check_invariant(r));
+
+	if (i > ring_size(r))
+		return NULL;
+
+	Ring res = ring_create();
+
+	if (ring_size(r) - i <= i)
+	{
+		for (uint64_t k = i; k < ring_size(r); ++k)
+			ring_append(res, _ring_slot(r, k));
+
+		_deque_truncate(r, i);
+	}
+	else
+	{
+		// res takes over the blocks, the head goes back to r
+		struct _Ring tmp = *r;
+
+		*r = *res;
+		*res = tmp;
+
+		while (ring_size(r) < i)
+			ring_append(r, ring_pop(res));
+	}
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Distributes the contend of r round robin over m rings.
+ * Complexity always O(n + m)
+ */
+Ring ring_distribute(Ring r, uint64_t m)
+{
+	ASSERT(ring_check_invariant(r));
+
+	if (!m)
+		m = 1;
+
+	Ring res = ring_create();
+	uint64_t i = 0;
+
+	for (uint64_t k = 0; k < m; ++k)
+		ring_append(res, ring_create());
+
+	// the rings are positions in res, no walk to reach one
+	for (ring_iterator(r))
+		ring_append(ring_at(res, i++ % m), ring_index);
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies the contend of the ring in order into out.
+ * Complexity always O(n)
+ */
+uint64_t ring_to_array(Ring r, cp* out, bool consume)
+{
+	uint64_t res = ring_size(r);
+
+	for (uint64_t done = 0; done < res; )
+	{
+		uint64_t at = r->head + done;
+		uint64_t n = B - at % B;
+
+		if (n > res - done)
+			n = res - done;
+
+		memcpy(out + done, r->map[at / B] + at % B, n * sizeof(cp));
+		done += n;
+	}
+
+	if (consume)
+		_deque_clear(r);
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a ring holding the n elements of arr.
+ * Complexity always O(n)
+ */
+Ring ring_from_array(const cp* arr, uint64_t n)
+{
+	Ring res = ring_create();
+
+	for (uint64_t i = 0; i < n; ++i)
+		ring_append(res, arr[i]);
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * True if c is an element of the ring.
+ * Complexity O(n)
+ */
+bool ring_find(Ring r, cp c)
+{
+	uint64_t pos;
+
+	return _deque_scan(r, c, true, &pos) != 0;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Position of the first occurence of c in the ring.
+ * Complexity O(n)
+ */
+int64_t ring_index_of(Ring r, cp c)
+{
+	uint64_t pos;
+
+	if (!_deque_scan(r, c, true, &pos))
+		return -1;
+
+	return (int64_t)pos;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements equal to c.
+ * Complexity always O(n)
+ */
+uint64_t ring_count_eq(Ring r, cp c)
+{
+	return _deque_scan(r, c, false, NULL);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Ring Invariant check.
+ * Complexity always O(map size)
+ */
+char* ring_invariant(Ring r)
+{
+	if (!r)
+		return "NULL POINTER EXCEP: Ring base struct undefinded";
+
+	if (!r->map)
+	{
+		if (r->size || r->head || r->map_size)
+			return "WRONG STRUCTURE: No map, but size, head or map size set";
+
+		return NULL;
+	}
+
+	if (r->head + r->size > r->map_size * B)
+		return "WRONG STRUCTURE: Elements past the end of the map";
+
+	for (uint64_t b = 0; b < r->map_size; ++b)
+	{
+		bool used = r->size && b >= r->head / B && b <= (r->head + r->size - 1) / B;
+
+		if (used && !r->map[b])
+			return "WRONG STRUCTURE: Block of an element is missing";
+
+		// an empty ring keeps the block of its head
+		if (!used && r->map[b] && (r->size || b != r->head / B))
+			return "WRONG STRUCTURE: Block without elements";
+	}
+
+	return NULL;
+}
+
+#if defined(INVARIANT_CHECKS) || defined(DEBUG)
+// -----------------------------------------------------------------------------
+/**
+ * Ring Invariant check with error output.
+ * Complexity always O(map size)
+ */
+bool ring_check_invariant(Ring r)
+{
+	char* msg = ring_invariant(r);
+	if(msg)
+	{
+		perr("%s", msg);
+		return false;
+	}
+
+	return true;
+}
+#endif
+
+
+#ifdef DEBUG
+// -----------------------------------------------------------------------------
+/**
+ * Print stats about the ring.
+ */
+void ring_print(FILE* f, Ring r, void(*pfunc)(FILE* f, cp c, uint64_t pos))
+{
+	uint64_t i = 0;
+	uint64_t blocks = 0;
+
+	for (uint64_t b = 0; b < r->map_size; ++b)
+		blocks += r->map[b] != NULL;
+
+	fprintf(f, "\n=========================================================\n");
+	fprintf(f, " RING SIZE   : %lu\n", ring_size(r));
+	fprintf(f, " MEMORY USED : %lu\n", sizeof(*r) + r->map_size * sizeof(cp*) + blocks * B * sizeof(cp));
+	fprintf(f, "---------------------------------------------------------\n");
+
+	for (ring_iterator(r))
+	{
+		if (!pfunc)
+			fprintf(f, " Pos: %3lu = %p\n", i++, ring_index);
+		else
+			pfunc(f, ring_index, i++);
+	}
+	fprintf(f, "---------------------------------------------------------\n");
+}
+
+#endif
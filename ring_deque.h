@@ -0,0 +1,374 @@
+/**
+ * Ring with a block deque layout: a map of pointers to fixed size blocks of
+ * contend pointers, like std::deque. Same ring_* names as ring.h for the
+ * sequence operations, but O(1) positional access, O(1) push, append, pop
+ * and chop and contiguous memory for iteration. Concatenation and splitting
+ * copy the smaller part.
+ *
+ * Include this header instead of ring.h and link libring_deque instead of
+ * libring to switch a program to this backend. The two can't be mixed in
+ * one program.
+ */
+
+#ifndef _RING_DEQUE_H_
+#define _RING_DEQUE_H_
+
+#ifdef _RING_H_
+#error "ring_deque.h and ring.h declare the same functions, include only one of them"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// contend pointer
+typedef void* cp;
+
+// Contend pointers per block, 4 KiB blocks on 64 bit
+#define RING_DEQUE_BLOCK 512
+
+// Base structure (Can't be opaque because of macro based interface)
+struct _Ring
+{
+	uint64_t size;
+	// Slot of the first element, counted from the start of the map
+	uint64_t head;
+	// Blocks of RING_DEQUE_BLOCK contend pointers. Blocks holding elements
+	// are allocated, all others are NULL (an empty ring may keep one)
+	cp** map;
+	uint64_t map_size;
+};
+
+// Just 'Ring' for the main data structure
+typedef struct _Ring* Ring;
+
+// Iterator state, see ring_iterator
+struct _RingIter
+{
+	cp** block;
+	cp* slot;
+	cp* end;
+	uint64_t left;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the ring size.
+ */
+#define ring_size(r) (r->size)
+
+// -----------------------------------------------------------------------------
+/**
+ * True if Ring is empty.
+ */
+#define ring_is_empty(r) (!ring_size(r))
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Slot of position i, an lvalue. i has to be in bounds.
+ */
+#define _ring_slot(r, i) \
+		(r->map[(r->head + (i)) / RING_DEQUE_BLOCK][(r->head + (i)) % RING_DEQUE_BLOCK])
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new Ring. The first block is allocated by the first push.
+ * Complexity always O(1)
+ */
+Ring ring_create(void);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the first element. NULL if the ring is empty.
+ * Complexity always O(1)
+ */
+#define ring_first(r) ( (ring_is_empty(r) ) ? NULL : _ring_slot(r, 0) )
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the last element. NULL if the ring is empty.
+ * Complexity always O(1)
+ */
+#define ring_last(r) ( (ring_is_empty(r) ) ? NULL : _ring_slot(r, ring_size(r) - 1) )
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys the ring. free_contend is called for every element if not NULL.
+ * Complexity always O(n / RING_DEQUE_BLOCK), O(n) with free_contend
+ */
+void ring_destroy(Ring r, void(*free_contend)(cp));
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the beginning of the ring.
+ * Complexity amortized O(1)
+ * @return always true, kept for the signature of ring.h.
+ */
+bool ring_push(Ring r, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the end of the ring.
+ * Complexity amortized O(1)
+ * @return always true, kept for the signature of ring.h.
+ */
+bool ring_append(Ring r, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element of the ring.
+ * NULL if the ring is empty.
+ * Complexity always O(1)
+ */
+cp ring_pop(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the last element of the ring.
+ * NULL if the ring is empty.
+ * Complexity always O(1)
+ */
+cp ring_chop(Ring r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Iterator over all members of the ring, used like the one of ring.h:
+ *
+ *	for( ring_iterator( r ) )
+ *	{
+ *		int * c = ring_index;
+ *		printf("%d\n", *c);
+ *	}
+ *
+ * ring_index can be assigned to. Don't add or remove members in the loop.
+ * The walk goes block by block through contiguous memory.
+ * Complexity O(n) if no break or goto is used.
+ */
+#define ring_iterator(r) struct _RingIter _iterat_ = _ring_iter(r); \
+		_iterat_.left; _ring_iter_step(&_iterat_)
+
+
+#define ring_index (*_iterat_.slot)
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Iterator on the first element. Used by ring_iterator.
+ */
+static inline struct _RingIter _ring_iter(Ring r)
+{
+	struct _RingIter it = { NULL, NULL, NULL, r->size };
+
+	if (it.left)
+	{
+		it.block = r->map + r->head / RING_DEQUE_BLOCK;
+		it.slot = *it.block + r->head % RING_DEQUE_BLOCK;
+		it.end = *it.block + RING_DEQUE_BLOCK;
+	}
+
+	return it;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the iterator to the next element. Used by ring_iterator.
+ */
+static inline void _ring_iter_step(struct _RingIter* it)
+{
+	it->left -= 1;
+
+	if (++it->slot == it->end && it->left)
+	{
+		it->block += 1;
+		it->slot = *it->block;
+		it->end = it->slot + RING_DEQUE_BLOCK;
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Return the contend of a specified position.
+ * NULL if out of bounds or the contend was NULL in the first place.
+ * Complexity always O(1)
+ */
+cp ring_at (Ring r, uint64_t i);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Extracts an element on a specified position. The elements on the shorter
+ * side of i move up by one.
+ * NULL if out of bounds or the contend was NULL in the first place.
+ * Complexity O(min(i, n - i))
+ */
+cp ring_extract(Ring r, uint64_t i);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Inserts an element on a specified position. The elements on the shorter
+ * side of i move by one to make room.
+ * Complexity O(min(i, n - i))
+ * @return false if i is out of bounds.
+ */
+bool ring_insert_at(Ring r, cp c, uint64_t i);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Moves the first k elements to the end, in order.
+ * Complexity O(min(k, n - k)) with k reduced modulo ring_size(r)
+ */
+void ring_rotate(Ring r, uint64_t k);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes all elements for which del_func returns true, in one pass.
+ * Complexity always O(n)
+ * @return A ring with the removed elements, in order.
+ */
+Ring ring_remove_selected(Ring r, bool(*del_func)(cp c, void* ud), void* ud);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Concatenation of two rings. Don't use r1 & r2 after the call of this function.
+ * Only the returned ring is supposed to be touched again. The elements of
+ * the smaller ring are copied into the larger one.
+ * Complexity O(min(n1, n2))
+ */
+Ring ring_concat(Ring r1, Ring r2);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Concatenation of k rings, in array order. Don't use any of the input rings
+ * after the call of this function.
+ * Complexity O(n)
+ */
+Ring ring_concat_n(Ring* rings, uint64_t k);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Splits the ring before position i. r keeps the first i elements, the
+ * returned ring holds the rest. The smaller part is copied, the larger one
+ * keeps its blocks.
+ * NULL if i is out of bounds.
+ * Complexity O(min(i, n - i))
+ */
+Ring ring_split_at(Ring r, uint64_t i);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Splits the ring in two halves, r keeps the first ring_size(r) / 2 elements.
+ * The smaller half is copied element by element, the other keeps its blocks.
+ * Complexity O(n / 2)
+ */
+#define ring_split_half(r) ring_split_at(r, ring_size(r) / 2)
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Distributes the contend of one ring round robin over m new rings, r is
+ * left untouched. A ring with m = 0 is treated like m = 1.
+ * Complexity always O(n + m)
+ * @return A ring containing m rings.
+ */
+Ring ring_distribute(Ring r, uint64_t m);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Copies the contend of the ring in order into out, which needs room for
+ * ring_size(r) elements. With consume the ring is empty afterwards.
+ * Complexity always O(n)
+ * @return Number of elements written.
+ */
+uint64_t ring_to_array(Ring r, cp* out, bool consume);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a ring holding the n elements of arr.
+ * Complexity always O(n)
+ */
+Ring ring_from_array(const cp* arr, uint64_t n);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * True if c is an element of the ring.
+ * Complexity O(n)
+ */
+bool ring_find(Ring r, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Position of the first occurence of c in the ring. -1 if there is none.
+ * Complexity O(n)
+ */
+int64_t ring_index_of(Ring r, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements equal to c.
+ * Complexity always O(n)
+ */
+uint64_t ring_count_eq(Ring r, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Ring Invariant check.
+ * Complexity always O(map size)
+ * @return If NULL -> Ring Ok. Else an error msg.
+ */
+char* ring_invariant(Ring r);
+
+
+#ifdef DEBUG
+#include <stdio.h>
+// -----------------------------------------------------------------------------
+/**
+ * Print stats about the ring.
+ */
+void ring_print(FILE* f, Ring r, void(*pfunc)(FILE* f, cp c, uint64_t pos));
+#endif
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * Helpers shared by the libring and libring_deque sources. Not installed,
+ * nothing in here is part of the interface.
+ */
+
+#ifndef _RING_INTERN_H_
+#define _RING_INTERN_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// DEBUGGING
+#if defined(INVARIANT_CHECKS) || defined(DEBUG)
+	#include <stdio.h>
+	#define perr(format, ...)  fprintf(stderr, "ERROR " format "\n", ## __VA_ARGS__)
+#endif
+
+#ifdef INVARIANT_CHECKS
+	#define EXIT_FAILURE_ASSERT 110
+	#define ASSERT(x, ...) \
+		if (!(x)) \
+		{\
+			perr("ASSERT FAILED: " #__VA_ARGS__ " (" #x ")   File: " \
+			__FILE__ "   Line: %d", __LINE__); \
+			exit(EXIT_FAILURE_ASSERT); \
+		}
+#else
+	#define ASSERT(x, ...)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Safe malloc. TODO implement user defind allocation function.
+ */
+static inline void* _smalloc(uint64_t s)
+{
+	void * res = malloc(s);
+	if (!res)
+		abort();
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Safe realloc.
+ */
+static inline void* _srealloc(void* p, uint64_t s)
+{
+	void * res = realloc(p, s);
+	if (!res)
+		abort();
+	return res;
+}
+
+#endif
@@ -0,0 +1,310 @@
+/**
+ * Compact rings inside a node pool.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+#include "ring_pool.h"
+#include "ring_intern.h"
+
+#include <stdlib.h>
+
+#define RING_POOL_INITIAL 1024
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Doubles the pool and links the new nodes into the free list.
+ */
+static void _pool_grow(RingPool p)
+{
+	uint64_t cap = p->capacity ? (uint64_t)p->capacity * 2 : RING_POOL_INITIAL;
+
+	// RING_POOL_NIL is no valid index
+	if (cap > RING_POOL_NIL)
+		cap = RING_POOL_NIL;
+
+	if (cap == p->capacity)
+		abort();
+
+	p->nodes = _srealloc(p->nodes, cap * sizeof(*p->nodes));
+
+	for (uint64_t i = p->capacity; i + 1 < cap; ++i)
+		p->nodes[i].next = (uint32_t)(i + 1);
+
+	p->nodes[cap - 1].next = p->free;
+	p->free = p->capacity;
+	p->capacity = (uint32_t)cap;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Offset of c from the pool base in units of the stride. False if c lies
+ * below base, between two strides or further than 4G strides above base.
+ */
+static inline bool _pool_offset(RingPool p, cp c, uint32_t* off)
+{
+	uintptr_t d = (uintptr_t)c - p->base;
+
+	if ((uintptr_t)c < p->base || d % p->stride || d / p->stride > UINT32_MAX)
+		return false;
+
+	*off = (uint32_t)(d / p->stride);
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Takes a node from the pool.
+ */
+static inline uint32_t _pool_node(RingPool p, uint32_t next, uint32_t off)
+{
+	if (p->free == RING_POOL_NIL)
+		_pool_grow(p);
+
+	uint32_t res = p->free;
+
+	p->free = p->nodes[res].next;
+	p->nodes[res].next = next;
+	p->nodes[res].contend = off;
+	p->used += 1;
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Gives a node back to the pool.
+ */
+static inline void _pool_free(RingPool p, uint32_t i)
+{
+	p->nodes[i].next = p->free;
+	p->free = i;
+	p->used -= 1;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Contend pointer of a node.
+ */
+static inline cp _pool_contend(RingPool p, uint32_t i)
+{
+	return (cp)(p->base + (uintptr_t)p->nodes[i].contend * p->stride);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// EXTERN INTERFACE FUNCTIONS
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a node pool.
+ * Complexity always O(1)
+ */
+RingPool ring_pool_create(void* base, uint32_t stride)
+{
+	RingPool res = _smalloc(sizeof(*res));
+
+	res->nodes = NULL;
+	res->capacity = 0;
+	res->free = RING_POOL_NIL;
+	res->used = 0;
+	res->base = (uintptr_t)base;
+	res->stride = stride ? stride : 1;
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a pool.
+ * Complexity always O(1)
+ */
+void ring_pool_destroy(RingPool p)
+{
+	free(p->nodes);
+	free(p);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Bytes of node memory the pool holds.
+ * Complexity always O(1)
+ */
+uint64_t ring_pool_bytes(RingPool p)
+{
+	return (uint64_t)p->capacity * sizeof(*p->nodes);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new ring inside the pool p.
+ * Complexity always O(1)
+ */
+PRing pring_create(RingPool p)
+{
+	PRing res = _smalloc(sizeof(*res));
+
+	res->size = 0;
+	res->first = RING_POOL_NIL;
+	res->last = RING_POOL_NIL;
+	res->pool = p;
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a ring, its nodes go back to the pool.
+ * Complexity always O(n)
+ */
+void pring_destroy(PRing r, void(*free_contend)(cp))
+{
+	ASSERT(!pring_invariant(r));
+
+	while (r->first != RING_POOL_NIL)
+	{
+		uint32_t delme = r->first;
+
+		r->first = r->pool->nodes[delme].next;
+
+		if (free_contend)
+			free_contend(_pool_contend(r->pool, delme));
+
+		_pool_free(r->pool, delme);
+	}
+
+	free(r);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the beginning of the ring.
+ * Complexity amortized O(1)
+ */
+bool pring_push(PRing r, cp c)
+{
+	uint32_t off;
+
+	if (!_pool_offset(r->pool, c, &off))
+		return false;
+
+	r->first = _pool_node(r->pool, r->first, off);
+
+	if (pring_is_empty(r))
+		r->last = r->first;
+
+	r->size += 1;
+
+	ASSERT(!pring_invariant(r));
+
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the end of the ring.
+ * Complexity amortized O(1)
+ */
+bool pring_append(PRing r, cp c)
+{
+	uint32_t off;
+
+	if (!_pool_offset(r->pool, c, &off))
+		return false;
+
+	uint32_t tmp = _pool_node(r->pool, RING_POOL_NIL, off);
+
+	if (pring_is_empty(r))
+		r->first = tmp;
+	else
+		r->pool->nodes[r->last].next = tmp;
+
+	r->last = tmp;
+	r->size += 1;
+
+	ASSERT(!pring_invariant(r));
+
+	return true;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element of the ring. 
+ * Complexity always O(1)
+ */
+cp pring_pop(PRing r)
+{
+	if (pring_is_empty(r))
+		return NULL;
+
+	uint32_t delme = r->first;
+	cp res = _pool_contend(r->pool, delme);
+
+	r->first = r->pool->nodes[delme].next;
+
+	if (pring_size(r) == 1)
+		r->last = RING_POOL_NIL;
+
+	r->size -= 1;
+	_pool_free(r->pool, delme);
+
+	ASSERT(!pring_invariant(r));
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Ring Invariant check.
+ * Complexity always O(n)
+ */
+char* pring_invariant(PRing r)
+{
+	if (!r)
+		return "NULL POINTER EXCEP: Ring base struct undefinded";
+
+	if (r->size == 0)
+	{
+		if (r->first != RING_POOL_NIL || r->last != RING_POOL_NIL)
+			return "WRONG STRUCTURE: Ring size = 0, but links are not NIL";
+
+		return NULL;
+	}
+
+	uint64_t pos = 1;
+	uint32_t i = r->first;
+
+	if (r->pool->nodes[r->last].next != RING_POOL_NIL)
+		return "WRONG STRUCTURE: Last Link->Next is not NIL";
+
+	for (; r->pool->nodes[i].next != RING_POOL_NIL; ++pos)
+	{
+		if (pos > r->size)
+			return "WRONG STRUCTURE: No NIL link found before size end reached";
+
+		i = r->pool->nodes[i].next;
+	}
+
+	if (pos != r->size)
+		return "WRONG STRUCTURE: Ring size != Counted Links";
+
+	if (i != r->last)
+		return "WRONG STRUCTURE: Last link != last Node";
+
+	return NULL;
+}
@@ -0,0 +1,192 @@
+/**
+ * Compact rings inside a node pool. Links are 32 bit indices into the pool
+ * and the contend is stored as 32 bit offset from a base address, so one
+ * node takes 8 bytes. Fifo and stack usage like Ring.
+ */
+
+#ifndef _RING_POOL_H_
+#define _RING_POOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ring.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// End of a chain
+#define RING_POOL_NIL UINT32_MAX
+
+// Pool node (Can't be opaque because of macro based interface)
+struct _PNode
+{
+	// Contend offset from the pool base, in units of the pool stride
+	uint32_t contend;
+	// Index of the next node
+	uint32_t next;
+};
+
+// Node pool (Can't be opaque because of macro based interface)
+struct _RingPool
+{
+	struct _PNode* nodes;
+	uint32_t capacity;
+	// head of the free list
+	uint32_t free;
+	// nodes in use
+	uint32_t used;
+	// contend = base + offset * stride
+	uintptr_t base;
+	uint32_t stride;
+};
+
+typedef struct _RingPool* RingPool;
+
+// Ring inside a pool (Can't be opaque because of macro based interface)
+struct _PRing
+{
+	uint64_t size;
+	uint32_t first;
+	uint32_t last;
+	RingPool pool;
+};
+
+typedef struct _PRing* PRing;
+
+// Iterator state, see pring_iterator
+struct _PIter
+{
+	struct _PNode* nodes;
+	uintptr_t base;
+	uint32_t stride;
+	uint32_t i;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE 
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a node pool. Contend pointers are stored as (c - base) / stride,
+ * so every element has to lie in the 4G * stride bytes above base and be
+ * stride aligned relative to it. With base NULL and stride 1 the contend
+ * is a plain 32 bit value (an index or handle casted to cp).
+ * Complexity always O(1)
+ */
+RingPool ring_pool_create(void* base, uint32_t stride);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a pool. All rings inside it are gone with it.
+ * Complexity always O(1)
+ */
+void ring_pool_destroy(RingPool p);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Bytes of node memory the pool holds.
+ * Complexity always O(1)
+ */
+uint64_t ring_pool_bytes(RingPool p);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns the ring size. 
+ */
+#define pring_size(r) ((r)->size)
+
+
+// -----------------------------------------------------------------------------
+/**
+ * True if the ring is empty.
+ */
+#define pring_is_empty(r) (!pring_size(r))
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a new ring inside the pool p.
+ * Complexity always O(1)
+ */
+PRing pring_create(RingPool p);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys a ring, its nodes go back to the pool.
+ * Complexity always O(n)
+ */
+void pring_destroy(PRing r, void(*free_contend)(cp));
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the beginning of the ring.
+ * Complexity amortized O(1)
+ * @return false if c can't be stored in the pool (see ring_pool_create),
+ * the ring is unchanged then.
+ */
+bool pring_push(PRing r, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the end of the ring.
+ * Complexity amortized O(1)
+ * @return false if c can't be stored in the pool (see ring_pool_create),
+ * the ring is unchanged then.
+ */
+bool pring_append(PRing r, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element of the ring. 
+ * NULL if the ring is empty.
+ * Complexity always O(1)
+ */
+cp pring_pop(PRing r);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Iterator over all members of the ring, used like ring_iterator:
+ *
+ *	for( pring_iterator( r ) )
+ *		printf("%p\n", pring_index);
+ *
+ * pring_index can't be assigned to. Don't add or remove members of any
+ * ring of the same pool in the loop.
+ * Complexity O(n) if no break or goto is used.
+ */
+#define pring_iterator(r) struct _PIter _piterat_ = \
+		{ (r)->pool->nodes, (r)->pool->base, (r)->pool->stride, (r)->first }; \
+		_piterat_.i != RING_POOL_NIL; _piterat_.i = _piterat_.nodes[_piterat_.i].next
+
+
+#define pring_index ((cp)(_piterat_.base + \
+		(uintptr_t)_piterat_.nodes[_piterat_.i].contend * _piterat_.stride))
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Ring Invariant check.
+ * Complexity always O(n)
+ * @return If NULL -> Ring Ok. Else an error msg.
+ */
+char* pring_invariant(PRing r);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ * Sharded multi-queue on top of Ring.
+ */
+
+#define _GNU_SOURCE
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+#include "ring_sharded.h"
+#include "ring_intern.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// one shard per cache line pair, no false sharing between neighbours
+struct _RingShard
+{
+	pthread_mutex_t lock;
+	Ring ring;
+} __attribute__((aligned(128)));
+
+struct _RingSharded
+{
+	uint32_t n;
+	struct _RingShard* shards;
+};
+
+// shard slot of the calling thread, 0 until the first use
+static __thread uint32_t _local_slot;
+// steal victim generator of the calling thread
+static __thread uint32_t _local_rand;
+// slot counter for new threads
+static uint32_t _next_slot;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Local shard of the calling thread. Threads get slots round robin.
+ */
+static inline struct _RingShard* _sharded_local(RingSharded s)
+{
+	if (!_local_slot)
+	{
+		_local_slot = __atomic_add_fetch(&_next_slot, 1, __ATOMIC_RELAXED);
+		_local_rand = _local_slot * 2654435761u | 1;
+	}
+
+	return s->shards + (_local_slot - 1) % s->n;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * xorshift32, per thread.
+ */
+static inline uint32_t _sharded_rand(void)
+{
+	uint32_t x = _local_rand;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	return _local_rand = x;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Pops from one shard. NULL and *hit = false if it was empty.
+ */
+static inline cp _sharded_pop_from(struct _RingShard* sh, bool* hit)
+{
+	cp res = NULL;
+
+	pthread_mutex_lock(&sh->lock);
+
+	*hit = !ring_is_empty(sh->ring);
+
+	if (*hit)
+		res = ring_pop(sh->ring);
+
+	pthread_mutex_unlock(&sh->lock);
+
+	return res;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Racy size of a shard, good enough to pick a victim.
+ */
+static inline uint64_t _sharded_peek(struct _RingShard* sh)
+{
+	return __atomic_load_n(&sh->ring->size, __ATOMIC_RELAXED);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// EXTERN INTERFACE FUNCTIONS
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a sharded queue with n shards.
+ * Complexity always O(n)
+ */
+RingSharded ring_sharded_create(uint32_t n)
+{
+	if (!n)
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		n = cpus > 0 ? (uint32_t)cpus : 1;
+	}
+
+	RingSharded res = _smalloc(sizeof(*res));
+	void* shards = NULL;
+
+	if (posix_memalign(&shards, 128, n * sizeof(struct _RingShard)))
+		abort();
+
+	res->n = n;
+	res->shards = shards;
+
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		pthread_mutex_init(&res->shards[i].lock, NULL);
+		res->shards[i].ring = ring_create();
+	}
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys the queue and all shards.
+ * Complexity always O(n)
+ */
+void ring_sharded_destroy(RingSharded s, void(*free_contend)(cp))
+{
+	for (uint32_t i = 0; i < s->n; ++i)
+	{
+		ring_destroy(s->shards[i].ring, free_contend);
+		pthread_mutex_destroy(&s->shards[i].lock);
+	}
+
+	free(s->shards);
+	free(s);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the end of the local shard.
+ * Complexity always O(1)
+ */
+void ring_sharded_append(RingSharded s, cp c)
+{
+	struct _RingShard* sh = _sharded_local(s);
+
+	pthread_mutex_lock(&sh->lock);
+	ring_append(sh->ring, c);
+	pthread_mutex_unlock(&sh->lock);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns an element, local shard first.
+ * Complexity O(1), O(shards) if most shards are empty
+ */
+cp ring_sharded_pop(RingSharded s)
+{
+	struct _RingShard* local = _sharded_local(s);
+	bool hit;
+	cp res = _sharded_pop_from(local, &hit);
+
+	if (hit || s->n == 1)
+		return res;
+
+	// power of two choices: steal from the fuller of two random shards
+	struct _RingShard* v1 = s->shards + _sharded_rand() % s->n;
+	struct _RingShard* v2 = s->shards + _sharded_rand() % s->n;
+	struct _RingShard* victim = _sharded_peek(v1) >= _sharded_peek(v2) ? v1 : v2;
+
+	if (victim != local && _sharded_peek(victim))
+	{
+		res = _sharded_pop_from(victim, &hit);
+
+		if (hit)
+			return res;
+	}
+
+	// everything looks empty, make sure by visiting all shards once
+	uint32_t start = _sharded_rand() % s->n;
+
+	for (uint32_t i = 0; i < s->n; ++i)
+	{
+		struct _RingShard* sh = s->shards + (start + i) % s->n;
+
+		if (sh == local || !_sharded_peek(sh))
+			continue;
+
+		res = _sharded_pop_from(sh, &hit);
+
+		if (hit)
+			return res;
+	}
+
+	return NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements over all shards.
+ * Complexity always O(shards)
+ */
+uint64_t ring_sharded_size(RingSharded s)
+{
+	uint64_t res = 0;
+
+	for (uint32_t i = 0; i < s->n; ++i)
+		res += _sharded_peek(s->shards + i);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of shards.
+ * Complexity always O(1)
+ */
+uint32_t ring_sharded_shards(RingSharded s)
+{
+	return s->n;
+}
@@ -0,0 +1,85 @@
+/**
+ * Sharded multi-queue on top of Ring. One Ring per thread slot, appends go
+ * to the local shard, pops take from the local shard first and steal from
+ * the fuller one of two random shards otherwise. FIFO order only holds per
+ * shard, in exchange the queue scales with the number of cores.
+ */
+
+#ifndef _RING_SHARDED_H_
+#define _RING_SHARDED_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ring.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// Sharded queue (opaque)
+typedef struct _RingSharded* RingSharded;
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE 
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a sharded queue with n shards. 0 takes one shard per online CPU.
+ * Complexity always O(n)
+ */
+RingSharded ring_sharded_create(uint32_t n);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys the queue and all shards. No other thread may use it anymore.
+ * Complexity always O(n)
+ */
+void ring_sharded_destroy(RingSharded s, void(*free_contend)(cp));
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the end of the local shard of the calling thread.
+ * Thread safe.
+ * Complexity always O(1)
+ */
+void ring_sharded_append(RingSharded s, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element of the local shard, or of another
+ * shard if the local one is empty. NULL if all shards are empty.
+ * Thread safe.
+ * Complexity O(1), O(shards) if most shards are empty
+ */
+cp ring_sharded_pop(RingSharded s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements over all shards. Only a hint while other threads
+ * modify the queue.
+ * Complexity always O(shards)
+ */
+uint64_t ring_sharded_size(RingSharded s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of shards.
+ * Complexity always O(1)
+ */
+uint32_t ring_sharded_shards(RingSharded s);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
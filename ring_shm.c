@@ -0,0 +1,454 @@
+/**
+ * Inter-process queue in a POSIX shared memory segment.
+ */
+
+#define _GNU_SOURCE
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+#include "ring_shm.h"
+#include "ring_intern.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+#define RING_SHM_MAGIC 0x6d68735f676e6972UL
+
+// offset of the first slot, 0 is the header and doubles as NULL link
+#define RING_SHM_HEAD 256
+
+// slot header, keeps the payload 16 byte aligned
+struct _ShmNode
+{
+	uint64_t next;
+	uint64_t pad;
+};
+
+// start of the segment, all links are offsets from here
+struct _ShmHead
+{
+	uint64_t magic;
+	uint64_t len;
+	uint64_t slots;
+	uint64_t slot_size;
+	uint64_t stride;
+
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+
+	// queue of appended slots
+	uint64_t first;
+	uint64_t last;
+	uint64_t size;
+
+	// free slots, a stack
+	uint64_t free;
+};
+
+_Static_assert(sizeof(struct _ShmHead) <= RING_SHM_HEAD, "ring_shm header too large");
+
+struct _RingShm
+{
+	char* base;
+	struct _ShmHead* head;
+	// mapped bytes
+	uint64_t len;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Offset <-> address of a slot header.
+ */
+static inline struct _ShmNode* _shm_node(RingShm s, uint64_t off)
+{
+	return (struct _ShmNode*)(s->base + off);
+}
+
+static inline uint64_t _shm_off(RingShm s, struct _ShmNode* n)
+{
+	return (uint64_t)((char*)n - s->base);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * A process that died holding the lock leaves it in EOWNERDEAD. The links
+ * are updated in a few stores, taking the lock over is the best we can do.
+ */
+static inline void _shm_lock(struct _ShmHead* h)
+{
+	if (pthread_mutex_lock(&h->lock) == EOWNERDEAD)
+		pthread_mutex_consistent(&h->lock);
+}
+
+static inline void _shm_wait(struct _ShmHead* h, pthread_cond_t* c)
+{
+	if (pthread_cond_wait(c, &h->lock) == EOWNERDEAD)
+		pthread_mutex_consistent(&h->lock);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Maps an open segment file of len bytes.
+ */
+static RingShm _shm_map(int fd, uint64_t len)
+{
+	void* base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	close(fd);
+
+	if (base == MAP_FAILED)
+		return NULL;
+
+	RingShm res = _smalloc(sizeof(*res));
+
+	res->base = base;
+	res->head = base;
+	res->len = len;
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Unlinks the first free slot, the lock is held.
+ */
+static inline void* _shm_take(RingShm s)
+{
+	struct _ShmHead* h = s->head;
+	struct _ShmNode* n = _shm_node(s, h->free);
+
+	h->free = n->next;
+	n->next = 0;
+
+	return n + 1;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Unlinks the first queued slot, the lock is held.
+ */
+static inline void* _shm_unqueue(RingShm s)
+{
+	struct _ShmHead* h = s->head;
+	struct _ShmNode* n = _shm_node(s, h->first);
+
+	h->first = n->next;
+	h->size -= 1;
+
+	if (!h->first)
+		h->last = 0;
+
+	return n + 1;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// EXTERN INTERFACE FUNCTIONS
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates and maps the segment.
+ * Complexity always O(slots)
+ */
+RingShm ring_shm_create(const char* name, uint64_t slots, uint64_t slot_size)
+{
+	if (!slots)
+		return NULL;
+
+	uint64_t stride = sizeof(struct _ShmNode) + ((slot_size + 15) & ~15UL);
+	uint64_t len = RING_SHM_HEAD + slots * stride;
+
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+
+	if (fd < 0)
+		return NULL;
+
+	if (ftruncate(fd, len))
+	{
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+
+	RingShm res = _shm_map(fd, len);
+
+	if (!res)
+	{
+		shm_unlink(name);
+		return NULL;
+	}
+
+	struct _ShmHead* h = res->head;
+
+	pthread_mutexattr_t ma;
+	pthread_mutexattr_init(&ma);
+	pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&h->lock, &ma);
+	pthread_mutexattr_destroy(&ma);
+
+	pthread_condattr_t ca;
+	pthread_condattr_init(&ca);
+	pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+	pthread_cond_init(&h->not_empty, &ca);
+	pthread_cond_init(&h->not_full, &ca);
+	pthread_condattr_destroy(&ca);
+
+	h->len = len;
+	h->slots = slots;
+	h->slot_size = slot_size;
+	h->stride = stride;
+	h->first = h->last = h->size = 0;
+
+	// the free stack hands out slots in address order
+	h->free = 0;
+	for (uint64_t i = slots; i > 0; --i)
+	{
+		uint64_t off = RING_SHM_HEAD + (i - 1) * stride;
+
+		_shm_node(res, off)->next = h->free;
+		h->free = off;
+	}
+
+	// openers check the magic, it goes last
+	__atomic_store_n(&h->magic, RING_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Maps an existing segment.
+ * Complexity always O(1)
+ */
+RingShm ring_shm_open(const char* name)
+{
+	int fd = shm_open(name, O_RDWR, 0);
+	struct stat st;
+
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) || (uint64_t)st.st_size < RING_SHM_HEAD)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	RingShm res = _shm_map(fd, st.st_size);
+
+	if (res && (__atomic_load_n(&res->head->magic, __ATOMIC_ACQUIRE) != RING_SHM_MAGIC ||
+			res->head->len != (uint64_t)st.st_size))
+	{
+		ring_shm_close(res);
+		return NULL;
+	}
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Unmaps the queue.
+ * Complexity always O(1)
+ */
+void ring_shm_close(RingShm s)
+{
+	munmap(s->base, s->len);
+	free(s);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the segment name.
+ * Complexity always O(1)
+ */
+bool ring_shm_unlink(const char* name)
+{
+	return shm_unlink(name) == 0;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Takes a free slot. NULL if all slots are in use.
+ * Complexity always O(1)
+ */
+void* ring_shm_reserve(RingShm s)
+{
+	void* res = NULL;
+
+	_shm_lock(s->head);
+
+	if (s->head->free)
+		res = _shm_take(s);
+
+	pthread_mutex_unlock(&s->head->lock);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Takes a free slot, waits for one.
+ * Complexity always O(1)
+ */
+void* ring_shm_reserve_wait(RingShm s)
+{
+	_shm_lock(s->head);
+
+	while (!s->head->free)
+		_shm_wait(s->head, &s->head->not_full);
+
+	void* res = _shm_take(s);
+
+	// more producers may be waiting while slots are still free
+	if (s->head->free)
+		pthread_cond_signal(&s->head->not_full);
+
+	pthread_mutex_unlock(&s->head->lock);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Appends a reserved slot.
+ * Complexity always O(1)
+ */
+void ring_shm_append(RingShm s, void* slot)
+{
+	struct _ShmHead* h = s->head;
+	struct _ShmNode* n = (struct _ShmNode*)slot - 1;
+	uint64_t off = _shm_off(s, n);
+
+	n->next = 0;
+
+	_shm_lock(h);
+
+	if (h->last)
+		_shm_node(s, h->last)->next = off;
+	else
+		h->first = off;
+
+	h->last = off;
+	h->size += 1;
+
+	if (h->size == 1)
+		pthread_cond_signal(&h->not_empty);
+
+	pthread_mutex_unlock(&h->lock);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first slot. NULL if the queue is empty.
+ * Complexity always O(1)
+ */
+void* ring_shm_pop(RingShm s)
+{
+	void* res = NULL;
+
+	_shm_lock(s->head);
+
+	if (s->head->first)
+		res = _shm_unqueue(s);
+
+	pthread_mutex_unlock(&s->head->lock);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first slot, waits for one.
+ * Complexity always O(1)
+ */
+void* ring_shm_pop_wait(RingShm s)
+{
+	_shm_lock(s->head);
+
+	while (!s->head->first)
+		_shm_wait(s->head, &s->head->not_empty);
+
+	void* res = _shm_unqueue(s);
+
+	// more consumers may be waiting on a queue that is still not empty
+	if (s->head->first)
+		pthread_cond_signal(&s->head->not_empty);
+
+	pthread_mutex_unlock(&s->head->lock);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns a slot to the free slots.
+ * Complexity always O(1)
+ */
+void ring_shm_release(RingShm s, void* slot)
+{
+	struct _ShmHead* h = s->head;
+	struct _ShmNode* n = (struct _ShmNode*)slot - 1;
+
+	_shm_lock(h);
+
+	n->next = h->free;
+	h->free = _shm_off(s, n);
+
+	if (!n->next)
+		pthread_cond_signal(&h->not_full);
+
+	pthread_mutex_unlock(&h->lock);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of queued slots.
+ * Complexity always O(1)
+ */
+uint64_t ring_shm_size(RingShm s)
+{
+	return __atomic_load_n(&s->head->size, __ATOMIC_RELAXED);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Payload bytes per slot.
+ * Complexity always O(1)
+ */
+uint64_t ring_shm_slot_size(RingShm s)
+{
+	return s->head->slot_size;
+}
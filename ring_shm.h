@@ -0,0 +1,144 @@
+/**
+ * Inter-process queue in a POSIX shared memory segment. The segment holds a
+ * fixed number of payload slots linked by offsets, so every process can map
+ * it at its own address. A producer reserves a slot, writes the payload in
+ * place and appends it, a consumer pops it, reads it in place and releases
+ * it, nothing is copied. A process shared, robust mutex (futex based)
+ * guards the links, waiting is done on process shared condition variables.
+ */
+
+#ifndef _RING_SHM_H_
+#define _RING_SHM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ring.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// Handle of a mapped queue, one per process (opaque)
+typedef struct _RingShm* RingShm;
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE 
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates the segment name ("/name", see shm_open) with slots payload slots
+ * of slot_size bytes each and maps it. Payloads are 16 byte aligned.
+ * Complexity always O(slots)
+ * @return NULL if the segment exists already or can not be created.
+ */
+RingShm ring_shm_create(const char* name, uint64_t slots, uint64_t slot_size);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Maps a segment created by ring_shm_create in another process.
+ * Complexity always O(1)
+ * @return NULL if there is no such segment or it is not a queue.
+ */
+RingShm ring_shm_open(const char* name);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Unmaps the queue from the calling process, the segment stays alive.
+ * Slots reserved or popped by this process and not handed back are lost.
+ * Complexity always O(1)
+ */
+void ring_shm_close(RingShm s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes the segment name. Processes that mapped it keep using it.
+ * Complexity always O(1)
+ * @return false if there is no such segment.
+ */
+bool ring_shm_unlink(const char* name);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Takes a free slot for writing a payload. NULL if all slots are in use.
+ * Multi process safe.
+ * Complexity always O(1)
+ */
+void* ring_shm_reserve(RingShm s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Takes a free slot for writing a payload, waits for one if all are in use.
+ * Multi process safe.
+ * Complexity always O(1)
+ */
+void* ring_shm_reserve_wait(RingShm s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Appends a reserved slot to the queue, the payload is visible to the
+ * consumer afterwards.
+ * Multi process safe.
+ * Complexity always O(1)
+ */
+void ring_shm_append(RingShm s, void* slot);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first slot. NULL if the queue is empty.
+ * Hand it back with ring_shm_release after reading.
+ * Multi process safe.
+ * Complexity always O(1)
+ */
+void* ring_shm_pop(RingShm s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first slot, waits for one if the queue is empty.
+ * Multi process safe.
+ * Complexity always O(1)
+ */
+void* ring_shm_pop_wait(RingShm s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Returns a popped (or unused reserved) slot to the free slots.
+ * Multi process safe.
+ * Complexity always O(1)
+ */
+void ring_shm_release(RingShm s, void* slot);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of queued slots. Only a hint while other processes use the queue.
+ * Complexity always O(1)
+ */
+uint64_t ring_shm_size(RingShm s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Payload bytes per slot.
+ * Complexity always O(1)
+ */
+uint64_t ring_shm_slot_size(RingShm s);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
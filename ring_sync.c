@@ -0,0 +1,329 @@
+/**
+ * Thread safe, optionally bounded queue on top of Ring.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// HEADER
+#include "ring_sync.h"
+#include "ring_intern.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+struct _RingSync
+{
+	pthread_mutex_t lock;
+	// signaled when an element arrives
+	pthread_cond_t not_empty;
+	// signaled when an element leaves a full RING_BLOCK queue
+	pthread_cond_t not_full;
+	// bounded for RING_REJECT and RING_DROP_OLDEST, the blocking is done here
+	Ring ring;
+	uint64_t cap;
+	enum RingPolicy policy;
+	uint64_t blocks;
+	// eventfd for event loops, -1 until ring_sync_fd
+	int efd;
+	uint64_t signals;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS INTERN
+
+// -----------------------------------------------------------------------------
+/**
+ * Pops with the lock held and wakes a waiting producer. Every pop makes
+ * room for one, not only the one from a full queue: two pops before the
+ * first woken producer gets the lock need two producers woken.
+ */
+static inline cp _sync_pop_locked(RingSync s)
+{
+	uint64_t size = ring_size(s->ring);
+	cp res = ring_pop(s->ring);
+
+	// NULL is valid contend, and CoDel may have dropped more than one
+	if (s->policy == RING_BLOCK && s->cap)
+	{
+		if (size - ring_size(s->ring) > 1)
+			pthread_cond_broadcast(&s->not_full);
+		else if (size != ring_size(s->ring))
+			pthread_cond_signal(&s->not_full);
+	}
+
+	return res;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// EXTERN INTERFACE FUNCTIONS
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a queue for at most cap elements.
+ * Complexity always O(1)
+ */
+RingSync ring_sync_create(uint64_t cap, enum RingPolicy policy)
+{
+	RingSync res = _smalloc(sizeof(*res));
+
+	pthread_mutex_init(&res->lock, NULL);
+	pthread_cond_init(&res->not_empty, NULL);
+	pthread_cond_init(&res->not_full, NULL);
+
+	res->cap = cap;
+	res->policy = policy;
+	res->blocks = 0;
+	res->efd = -1;
+	res->signals = 0;
+	res->ring = cap && policy != RING_BLOCK ? ring_create_bounded(cap, policy) : ring_create();
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys the queue.
+ * Complexity always O(n)
+ */
+void ring_sync_destroy(RingSync s, void(*free_contend)(cp))
+{
+	ring_destroy(s->ring, free_contend);
+
+	if (s->efd >= 0)
+		close(s->efd);
+
+	pthread_cond_destroy(&s->not_full);
+	pthread_cond_destroy(&s->not_empty);
+	pthread_mutex_destroy(&s->lock);
+
+	free(s);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Sets the callback for dropped elements.
+ * Complexity always O(1)
+ */
+void ring_sync_on_drop(RingSync s, void(*dropped)(cp c, void* ud), void* ud)
+{
+	pthread_mutex_lock(&s->lock);
+	ring_on_drop(s->ring, dropped, ud);
+	pthread_mutex_unlock(&s->lock);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the end.
+ * Complexity always O(1)
+ */
+bool ring_sync_append(RingSync s, cp c)
+{
+	pthread_mutex_lock(&s->lock);
+
+	if (s->policy == RING_BLOCK && s->cap && ring_size(s->ring) >= s->cap)
+	{
+		s->blocks += 1;
+
+		while (ring_size(s->ring) >= s->cap)
+			pthread_cond_wait(&s->not_full, &s->lock);
+	}
+
+	bool res = ring_append(s->ring, c);
+	int efd = -1;
+
+	if (res && ring_size(s->ring) == 1)
+	{
+		pthread_cond_broadcast(&s->not_empty);
+
+		if (s->efd >= 0)
+		{
+			efd = s->efd;
+			s->signals += 1;
+		}
+	}
+
+	pthread_mutex_unlock(&s->lock);
+
+	// a consumer that reset the fd before the append sees this write, one
+	// that drains in between only gets a spurious wakeup
+	if (efd >= 0)
+	{
+		uint64_t one = 1;
+
+		if (write(efd, &one, sizeof(one)) < 0)
+			abort();
+	}
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element. NULL if the queue is empty.
+ * Complexity always O(1)
+ */
+cp ring_sync_pop(RingSync s)
+{
+	pthread_mutex_lock(&s->lock);
+
+	cp res = _sync_pop_locked(s);
+
+	pthread_mutex_unlock(&s->lock);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element, waits for one.
+ * Complexity always O(1)
+ */
+cp ring_sync_pop_wait(RingSync s)
+{
+	pthread_mutex_lock(&s->lock);
+
+	while (ring_is_empty(s->ring))
+		pthread_cond_wait(&s->not_empty, &s->lock);
+
+	cp res = _sync_pop_locked(s);
+
+	pthread_mutex_unlock(&s->lock);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements.
+ * Complexity always O(1)
+ */
+uint64_t ring_sync_size(RingSync s)
+{
+	return __atomic_load_n(&s->ring->size, __ATOMIC_RELAXED);
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Counters of the capacity policy.
+ * Complexity always O(1)
+ */
+uint64_t ring_sync_drops(RingSync s)
+{
+	pthread_mutex_lock(&s->lock);
+	uint64_t res = ring_drops(s->ring);
+	pthread_mutex_unlock(&s->lock);
+
+	return res;
+}
+
+uint64_t ring_sync_rejects(RingSync s)
+{
+	pthread_mutex_lock(&s->lock);
+	uint64_t res = ring_rejects(s->ring);
+	pthread_mutex_unlock(&s->lock);
+
+	return res;
+}
+
+uint64_t ring_sync_blocks(RingSync s)
+{
+	pthread_mutex_lock(&s->lock);
+	uint64_t res = s->blocks;
+	pthread_mutex_unlock(&s->lock);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * eventfd of the queue, created on the first call.
+ * Complexity always O(1)
+ */
+int ring_sync_fd(RingSync s)
+{
+	pthread_mutex_lock(&s->lock);
+
+	if (s->efd < 0)
+	{
+		__atomic_store_n(&s->efd, eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), __ATOMIC_RELEASE);
+
+		// elements that are already there need a signal as well
+		if (s->efd >= 0 && !ring_is_empty(s->ring))
+		{
+			uint64_t one = 1;
+
+			if (write(s->efd, &one, sizeof(one)) < 0)
+				abort();
+
+			s->signals += 1;
+		}
+	}
+
+	int res = s->efd;
+
+	pthread_mutex_unlock(&s->lock);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Resets the eventfd and takes all elements.
+ * Complexity always O(1)
+ */
+Ring ring_sync_pop_all(RingSync s)
+{
+	uint64_t count;
+	int efd = __atomic_load_n(&s->efd, __ATOMIC_ACQUIRE);
+
+	// reset first, appends from now on signal again
+	if (efd >= 0)
+		while (read(efd, &count, sizeof(count)) < 0 && errno == EINTR)
+			;
+
+	pthread_mutex_lock(&s->lock);
+
+	bool full = s->policy == RING_BLOCK && s->cap && ring_size(s->ring) >= s->cap;
+	Ring res = ring_split_at(s->ring, 0);
+
+	if (full)
+		pthread_cond_broadcast(&s->not_full);
+
+	pthread_mutex_unlock(&s->lock);
+
+	return res;
+}
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of eventfd signals.
+ * Complexity always O(1)
+ */
+uint64_t ring_sync_signals(RingSync s)
+{
+	pthread_mutex_lock(&s->lock);
+	uint64_t res = s->signals;
+	pthread_mutex_unlock(&s->lock);
+
+	return res;
+}
@@ -0,0 +1,141 @@
+/**
+ * Thread safe, optionally bounded queue on top of Ring. One mutex guards the
+ * ring, RING_BLOCK makes producers wait on a condition variable until a
+ * consumer made room, ring_sync_pop_wait makes consumers wait for elements.
+ * Event loops wait on ring_sync_fd with epoll instead.
+ */
+
+#ifndef _RING_SYNC_H_
+#define _RING_SYNC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ring.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// TYPES
+
+// Thread safe queue (opaque)
+typedef struct _RingSync* RingSync;
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE 
+
+// -----------------------------------------------------------------------------
+/**
+ * Creates a queue for at most cap elements, 0 for an unbounded one. The
+ * policy applies once it is full, see enum RingPolicy.
+ * Complexity always O(1)
+ */
+RingSync ring_sync_create(uint64_t cap, enum RingPolicy policy);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Destroys the queue. No other thread may use or wait on it anymore.
+ * Complexity always O(n)
+ */
+void ring_sync_destroy(RingSync s, void(*free_contend)(cp));
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Sets the callback for elements dropped by RING_DROP_OLDEST. It runs with
+ * the queue locked.
+ * Complexity always O(1)
+ */
+void ring_sync_on_drop(RingSync s, void(*dropped)(cp c, void* ud), void* ud);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Adds one element at the end. With RING_BLOCK a full queue makes the
+ * caller wait for room.
+ * Thread safe.
+ * Complexity always O(1)
+ * @return false if the full queue refused the element (RING_REJECT).
+ */
+bool ring_sync_append(RingSync s, cp c);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element. NULL if the queue is empty.
+ * Thread safe.
+ * Complexity always O(1)
+ */
+cp ring_sync_pop(RingSync s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Removes and returns the first element, waits for one if the queue is
+ * empty.
+ * Thread safe.
+ * Complexity always O(1)
+ */
+cp ring_sync_pop_wait(RingSync s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements. Only a hint while other threads modify the queue.
+ * Complexity always O(1)
+ */
+uint64_t ring_sync_size(RingSync s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of elements dropped (RING_DROP_OLDEST) and refused (RING_REJECT),
+ * and how often a producer had to wait (RING_BLOCK).
+ * Complexity always O(1)
+ */
+uint64_t ring_sync_drops(RingSync s);
+uint64_t ring_sync_rejects(RingSync s);
+uint64_t ring_sync_blocks(RingSync s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * eventfd of the queue for poll/epoll, created by the first call. From then
+ * on an append to the empty queue makes it readable; appends to a non-empty
+ * queue don't touch it. Consume with ring_sync_pop_all on every wakeup so
+ * no element is left behind without a signal. The queue owns the fd.
+ * Thread safe.
+ * Complexity always O(1)
+ * @return The fd, -1 if eventfd failed (errno is set).
+ */
+int ring_sync_fd(RingSync s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Resets ring_sync_fd and takes all elements out of the queue at once, in
+ * order, as a ring of the caller. Producers waiting for room (RING_BLOCK)
+ * are woken up.
+ * Thread safe.
+ * Complexity always O(1)
+ * @return A ring with the elements, empty if there were none.
+ */
+Ring ring_sync_pop_all(RingSync s);
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Number of times ring_sync_fd was signaled.
+ * Complexity always O(1)
+ */
+uint64_t ring_sync_signals(RingSync s);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,249 @@
+/**
+ * Typed rings that store values of one type inside the nodes. A single
+ * allocation per element instead of a node plus the value behind a cp,
+ * and no extra load to reach the value. Use Ring for heterogenous contend.
+ *
+ *	RING_DEFINE(IntRing, int)
+ *
+ *	IntRing r = IntRing_create();
+ *	int v;
+ *
+ *	IntRing_append(r, 42);
+ *
+ *	for (ring_typed_iterator(IntRing, r))
+ *		ring_typed_index += 1;
+ *
+ *	while (IntRing_pop(r, &v))
+ *		printf("%d\n", v);
+ *
+ *	IntRing_destroy(r);
+ *
+ * RING_DEFINE generates static functions, so it can be placed in a header
+ * and used in several translation units.
+ */
+
+#ifndef _RING_TYPED_H_
+#define _RING_TYPED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Storage class of the generated functions. Unused ones are dropped without
+// a warning and -Winline doesn't complain about calls the compiler keeps.
+#ifdef __GNUC__
+	#define RING_TYPED_FUNC static __attribute__((unused))
+#else
+	#define RING_TYPED_FUNC static inline
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// INTERFACE
+
+// -----------------------------------------------------------------------------
+/**
+ * Iterator over all values of a ring of type name, the typed counterpart of
+ * ring_iterator. ring_typed_index is the value itself and can be assigned.
+ * The same rules as for ring_iterator apply.
+ * Complexity O(n) if no break or goto is used.
+ */
+#define ring_typed_iterator(name, r) struct _##name##Node* _titerat_ = (r)->first; \
+		_titerat_ != NULL; _titerat_ = _titerat_->next
+
+
+#define ring_typed_index (_titerat_->value)
+
+
+// -----------------------------------------------------------------------------
+/**
+ * Defines the ring type name for values of type T and its functions:
+ *
+ *	name name_create(void)                        O(1)
+ *	void name_destroy(name r)                     O(n)
+ *	uint64_t name_size(name r)                    O(1)
+ *	bool name_is_empty(name r)                    O(1)
+ *	void name_push(name r, T v)                   O(1)
+ *	void name_append(name r, T v)                 O(1)
+ *	bool name_pop(name r, T* out)                 O(1), false if empty
+ *	bool name_chop(name r, T* out)                O(n), false if empty
+ *	T* name_first(name r), T* name_last(name r)   O(1), NULL if empty
+ *	T* name_at(name r, uint64_t i)                O(i), NULL if out of bounds
+ *	name name_concat(name r1, name r2)            O(1), like ring_concat
+ *
+ * out of pop and chop may be NULL to drop the value. Values are copied in
+ * and out by assignment; pointers returned by first, last and at stay valid
+ * until the element is removed.
+ */
+#define RING_DEFINE(name, T) \
+\
+struct _##name##Node \
+{ \
+	struct _##name##Node* next; \
+	T value; \
+}; \
+\
+struct _##name \
+{ \
+	uint64_t size; \
+	struct _##name##Node* first; \
+	struct _##name##Node* last; \
+}; \
+\
+typedef struct _##name* name; \
+\
+RING_TYPED_FUNC void* _##name##_smalloc(uint64_t s) \
+{ \
+	void* res = malloc(s); \
+	if (!res) \
+		abort(); \
+	return res; \
+} \
+\
+RING_TYPED_FUNC name name##_create(void) \
+{ \
+	name res = _##name##_smalloc(sizeof(*res)); \
+\
+	res->size = 0; \
+	res->first = NULL; \
+	res->last = NULL; \
+\
+	return res; \
+} \
+\
+RING_TYPED_FUNC void name##_destroy(name r) \
+{ \
+	while (r->first) \
+	{ \
+		struct _##name##Node* n = r->first; \
+\
+		r->first = n->next; \
+		free(n); \
+	} \
+\
+	free(r); \
+} \
+\
+RING_TYPED_FUNC uint64_t name##_size(name r) \
+{ \
+	return r->size; \
+} \
+\
+RING_TYPED_FUNC bool name##_is_empty(name r) \
+{ \
+	return !r->size; \
+} \
+\
+RING_TYPED_FUNC void name##_push(name r, T v) \
+{ \
+	struct _##name##Node* n = _##name##_smalloc(sizeof(*n)); \
+\
+	n->value = v; \
+	n->next = r->first; \
+	r->first = n; \
+\
+	if (!r->size) \
+		r->last = n; \
+\
+	r->size += 1; \
+} \
+\
+RING_TYPED_FUNC void name##_append(name r, T v) \
+{ \
+	struct _##name##Node* n = _##name##_smalloc(sizeof(*n)); \
+\
+	n->value = v; \
+	n->next = NULL; \
+\
+	if (r->size) \
+		r->last->next = n; \
+	else \
+		r->first = n; \
+\
+	r->last = n; \
+	r->size += 1; \
+} \
+\
+RING_TYPED_FUNC bool name##_pop(name r, T* out) \
+{ \
+	struct _##name##Node* n = r->first; \
+\
+	if (!n) \
+		return false; \
+\
+	if (out) \
+		*out = n->value; \
+\
+	r->first = n->next; \
+	r->size -= 1; \
+\
+	if (!r->size) \
+		r->last = NULL; \
+\
+	free(n); \
+	return true; \
+} \
+\
+RING_TYPED_FUNC bool name##_chop(name r, T* out) \
+{ \
+	if (r->size < 2) \
+		return name##_pop(r, out); \
+\
+	struct _##name##Node* prev = r->first; \
+\
+	while (prev->next != r->last) \
+		prev = prev->next; \
+\
+	if (out) \
+		*out = r->last->value; \
+\
+	free(r->last); \
+	prev->next = NULL; \
+	r->last = prev; \
+	r->size -= 1; \
+\
+	return true; \
+} \
+\
+RING_TYPED_FUNC T* name##_first(name r) \
+{ \
+	return r->size ? &r->first->value : NULL; \
+} \
+\
+RING_TYPED_FUNC T* name##_last(name r) \
+{ \
+	return r->size ? &r->last->value : NULL; \
+} \
+\
+RING_TYPED_FUNC T* name##_at(name r, uint64_t i) \
+{ \
+	if (i >= r->size) \
+		return NULL; \
+\
+	struct _##name##Node* n = r->first; \
+\
+	while (i--) \
+		n = n->next; \
+\
+	return &n->value; \
+} \
+\
+RING_TYPED_FUNC name name##_concat(name r1, name r2) \
+{ \
+	if (r2->size) \
+	{ \
+		if (r1->size) \
+			r1->last->next = r2->first; \
+		else \
+			r1->first = r2->first; \
+\
+		r1->last = r2->last; \
+		r1->size += r2->size; \
+	} \
+\
+	free(r2); \
+	return r1; \
+}
+
+
+#endif
@@ -0,0 +1,12 @@
+#!/bin/bash
+
+TARGET="testcases-deque"
+SRC="testcases_deque.c"
+
+## FLAGS
+CFLAGS="-O2 -std=c99 -pipe -Winline -Wall -Wextra -Werror -Wno-unused"
+LDLIBS="libring_deque.a"
+CC="gcc"
+
+make && $CC $CFLAGS -o $TARGET $SRC $LDLIBS && ./$TARGET
+
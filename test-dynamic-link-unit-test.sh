@@ -4,7 +4,7 @@ TARGET="testcases-dynamic"
 SRC="testcases.c"
 
 ## FLAGS
-CFLAGS="-O2 -std=c99 -pipe -Winline -Wall -Wextra -Werror -Wno-unused"
+CFLAGS="-O2 -std=c99 -pipe -pthread -Winline -Wall -Wextra -Werror -Wno-unused"
 LDFLAGS="-L. -lring"
 CC="gcc"
 
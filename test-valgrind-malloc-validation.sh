@@ -4,9 +4,9 @@ TARGET="testcases-valgrind"
 SRC="testcases.c"
 
 ## FLAGS
-CFLAGS="-O2 -std=c99 -pipe -Winline -Wall -Wextra -Werror -Wno-unused"
+CFLAGS="-O2 -std=c99 -pipe -pthread -Winline -Wall -Wextra -Werror -Wno-unused"
 LDFLAGS=""
-LDLIBS="libring.a"
+LDLIBS="libring.a -lrt"
 CC="gcc"
 
 
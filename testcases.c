@@ -3,14 +3,30 @@
  * @author Markus Wanke 
  */
 
+#define _GNU_SOURCE
+
 /* ---- System Header -------------------------------------------------------------- */
 #include <time.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
 
 /* ---- Own Header ----------------------------------------------------------------- */
 #include "ring.h"
+#include "ring_sharded.h"
+#include "ring_pool.h"
+#include "ring_bufchain.h"
+#include "ring_sync.h"
+#include "ring_shm.h"
+#include "ring_typed.h"
 
 /* ---- Helper Functions ----------------------------------------------------------- */
 	
@@ -32,7 +48,7 @@ void pfunc(FILE * f, cp c, uint64_t pos)
 
 /* ---- Test Functions ----------------------------------------------------------- */
 
-#define TEST_FUNC_ARRAY_SIZE 20
+#define TEST_FUNC_ARRAY_SIZE 64
 #define TEST_ARRAY_SIZE 2000
 
 void( *tests[TEST_FUNC_ARRAY_SIZE] )( void );
@@ -647,7 +663,2175 @@ void t_0A( void )
 	pinfo( "TA: ring_distribute success");
 }
 
+void t_0B( void )
+{
+	// heap ring, aged by push/pop/extract, then compacted
+	Ring r = ring_create();
+
+	for( uint32_t i = 0; i < 100; ++i )
+	{
+		ring_append( r, a+i );
+		ring_push( r, a+i );
+	}
+
+	for( uint32_t i = 0; i < 100; ++i )
+		ring_pop( r );
+
+	for( uint32_t i = 0; i < 50; ++i )
+		ring_extract( r, 25 );
+
+	ring_compact( r );
+
+	if( ring_arena( r ) == NULL || ring_size( r ) != 50 || ring_invariant( r ) )
+	{
+		perr( "T0B: compact size fail"); return;
+	}
+
+	uint32_t i = 0;
+	for( ring_iterator( r ) )
+	{
+		if( ring_index != a + (i < 25 ? i : i + 50) || _iterat_ != r->first + i )
+		{
+			perr( "T0B: compact order fail at %u", i); return;
+		}
+		++i;
+	}
+
+	// arena ring, old chunks released after compaction
+	RingArena arena = ring_arena_create( 16 );
+	Ring r2 = ring_create_in( arena );
+
+	for( i = 0; i < 64; ++i )
+		ring_append( r2, a+i );
+
+	for( i = 0; i < 32; ++i )
+		ring_pop( r2 );
+
+	ring_compact( r2 );
+
+	if( ring_arena_trim( arena ) != 64 * sizeof( struct _Node ) )
+	{
+		perr( "T0B: arena trim fail"); return;
+	}
+
+	for( i = 32; i < 64; ++i )
+	{
+		if( ring_pop( r2 ) != a+i )
+		{
+			perr( "T0B: arena contend fail at %u", i); return;
+		}
+	}
+
+	// mixed concatenation: heap + arena + other arena
+	RingArena arena2 = ring_arena_create( 0 );
+	Ring r3 = ring_create_in( arena2 );
+	Ring r4 = ring_create();
+
+	for( i = 0; i < 10; ++i )
+	{
+		ring_append( r2, a+i );
+		ring_append( r3, a+i+10 );
+		ring_append( r4, a+i+20 );
+	}
+
+	ring_arena_destroy( arena );
+	ring_arena_destroy( arena2 );
+
+	r = ring_concat( r4, ring_concat( ring_concat( r2, r3 ), r ) );
+
+	if( ring_size( r ) != 80 || ring_invariant( r ) || ring_arena( r ) == NULL )
+	{
+		perr( "T0B: mixed concat fail"); return;
+	}
+
+	for( i = 0; i < 30; ++i )
+	{
+		if( ring_pop( r ) != a + (i + 20) % 30 )
+		{
+			perr( "T0B: mixed concat contend fail at %u", i); return;
+		}
+	}
+
+	Ring odds = ring_remove_selected( r, odd, NULL );
+	ring_destroy( odds, NULL );
+	ring_destroy( r, NULL );
+
+	// concat leaves the chunk tables of the merged arenas pending, lookups
+	// and trim have to see all of them
+	Ring parts[8];
+
+	for( i = 0; i < 8; ++i )
+	{
+		RingArena ar = ring_arena_create( 16 );
+
+		parts[i] = ring_create_in( ar );
+		ring_arena_destroy( ar );
+
+		for( int k = 0; k < 16; ++k )
+			ring_append( parts[i], a + 16 * i + k );
+	}
+
+	for( i = 0; i < 8; i += 2 )
+		parts[i] = ring_concat( parts[i], parts[i + 1] );
+
+	r = ring_concat( ring_concat( parts[0], parts[2] ), ring_concat( parts[4], parts[6] ) );
+
+	if( ring_size( r ) != 128 || ring_index_of( r, a + 127 ) != 127 || ring_count_eq( r, a + 64 ) != 1 ||
+		ring_invariant( r ) )
+	{
+		perr( "T0B: concat of arena rings fail"); return;
+	}
+
+	while( !ring_is_empty( r ) )
+		ring_pop( r );
+
+	if( ring_arena_trim( ring_arena( r ) ) != 128 * sizeof( struct _Node ) )
+	{
+		perr( "T0B: trim after concat of arena rings fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	pinfo( "TB: ring_compact & arenas success");
+}
+
+#define T0C_OPS 200000
+
+static Ring t0c_ring;
+static volatile bool t0c_done;
+static volatile bool t0c_fail;
+
+void* t_0C_reader( void* moot )
+{
+	uint64_t snapshots = 0;
+
+	while( !t0c_done || !snapshots )
+	{
+		RingSnapshot s;
+		cp c;
+		int32_t* prev = NULL;
+
+		if( !ring_snapshot_take( t0c_ring, &s ) )
+			continue;
+
+		// the writer appends a+i in order, every snapshot is a gapless run
+		while( ring_snapshot_next( &s, &c ) )
+		{
+			int32_t* p = c;
+
+			if( prev && ( p != prev + 1 || *p != *prev + 1 ) )
+				t0c_fail = true;
+
+			prev = p;
+		}
+
+		ring_snapshot_release( t0c_ring, &s );
+		++snapshots;
+	}
+
+	return NULL;
+}
+
+void t_0C( void )
+{
+	pthread_t readers[2];
+
+	t0c_ring = ring_create();
+	t0c_done = false;
+	t0c_fail = false;
+
+	if( !ring_rcu_enable( t0c_ring, 4 ) || ring_rcu_enable( t0c_ring, 4 ) )
+	{
+		perr( "T0C: enable fail"); return;
+	}
+
+	for( int i = 0; i < 2; ++i )
+		pthread_create( readers + i, NULL, t_0C_reader, NULL );
+
+	for( uint32_t i = 0; i < T0C_OPS; ++i )
+	{
+		ring_append( t0c_ring, a + i % TEST_ARRAY_SIZE );
+
+		if( i % TEST_ARRAY_SIZE == TEST_ARRAY_SIZE - 1 )
+			while( !ring_is_empty( t0c_ring ) )
+				ring_pop( t0c_ring );
+		else if( ring_size( t0c_ring ) > 100 )
+			ring_pop( t0c_ring );
+	}
+
+	t0c_done = true;
+
+	for( int i = 0; i < 2; ++i )
+		pthread_join( readers[i], NULL );
+
+	ring_rcu_reclaim( t0c_ring );
+
+	if( t0c_fail )
+	{
+		perr( "T0C: inconsistent snapshot"); return;
+	}
+
+	ring_destroy( t0c_ring, NULL );
+
+	pinfo( "TC: ring_snapshot concurrent readers success");
+}
+
+#define T0D_THREADS 4
+#define T0D_PER_THREAD ( TEST_ARRAY_SIZE / T0D_THREADS )
+
+static RingSharded t0d_queue;
+static uint32_t t0d_seen[TEST_ARRAY_SIZE];
+
+void* t_0D_worker( void* arg )
+{
+	int32_t base = (int32_t)(intptr_t)arg * T0D_PER_THREAD;
+	uint32_t popped = 0;
+
+	for( int32_t i = 0; i < T0D_PER_THREAD; ++i )
+	{
+		ring_sharded_append( t0d_queue, a + base + i );
+
+		if( i % 3 == 2 )
+		{
+			int32_t* p = ring_sharded_pop( t0d_queue );
+
+			if( p )
+			{
+				__atomic_add_fetch( t0d_seen + *p, 1, __ATOMIC_RELAXED );
+				++popped;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+void t_0D( void )
+{
+	pthread_t threads[T0D_THREADS];
+
+	// single thread: one shard, plain FIFO
+	t0d_queue = ring_sharded_create( T0D_THREADS );
+
+	for( int i = 0; i < 100; ++i )
+		ring_sharded_append( t0d_queue, a + i );
+
+	for( int i = 0; i < 100; ++i )
+	{
+		if( ring_sharded_pop( t0d_queue ) != a + i )
+		{
+			perr( "T0D: local fifo fail at %d", i); return;
+		}
+	}
+
+	if( ring_sharded_pop( t0d_queue ) != NULL || ring_sharded_size( t0d_queue ) )
+	{
+		perr( "T0D: empty fail"); return;
+	}
+
+	// threads: every element comes out exactly once
+	for( int i = 0; i < T0D_THREADS; ++i )
+		pthread_create( threads + i, NULL, t_0D_worker, (void*)(intptr_t)i );
+
+	for( int i = 0; i < T0D_THREADS; ++i )
+		pthread_join( threads[i], NULL );
+
+	int32_t* p;
+	while( ( p = ring_sharded_pop( t0d_queue ) ) )
+		t0d_seen[*p] += 1;
+
+	for( int i = 0; i < T0D_THREADS * T0D_PER_THREAD; ++i )
+	{
+		if( t0d_seen[i] != 1 )
+		{
+			perr( "T0D: element %d seen %u times", i, t0d_seen[i]); return;
+		}
+	}
+
+	ring_sharded_destroy( t0d_queue, NULL );
+
+	pinfo( "TD: ring_sharded success");
+}
+
+void t_0E( void )
+{
+	Ring r = ring_create();
+
+	for( uint32_t i = 0; i < 10; ++i )
+		ring_append( r, a+i );
+
+	if( ring_split_at( r, 11 ) != NULL )
+	{
+		perr( "T0E: split out of bounds fail"); return;
+	}
+
+	Ring tail = ring_split_at( r, 10 );
+	Ring all = ring_split_at( r, 0 );
+
+	if( ring_size( tail ) || ring_size( r ) || ring_size( all ) != 10 
+	||  ring_invariant( r ) || ring_invariant( all ) )
+	{
+		perr( "T0E: split edge fail"); return;
+	}
+
+	Ring parts[5];
+
+	parts[0] = r;
+	parts[4] = tail;
+	parts[1] = all;
+	parts[3] = ring_split_half( parts[1] );
+	parts[2] = ring_split_at( parts[1], 2 );
+
+	if( ring_size( parts[1] ) != 2 || ring_size( parts[2] ) != 3 || ring_size( parts[3] ) != 5
+	||  ring_last( parts[2] ) != a+4 || ring_first( parts[3] ) != a+5 )
+	{
+		perr( "T0E: split fail"); return;
+	}
+
+	r = ring_concat_n( parts, 5 );
+
+	if( ring_size( r ) != 10 || ring_invariant( r ) )
+	{
+		perr( "T0E: concat_n fail"); return;
+	}
+
+	for( uint32_t i = 0; i < 10; ++i )
+	{
+		if( ring_pop( r ) != a+i )
+		{
+			perr( "T0E: concat_n contend fail at %u", i); return;
+		}
+	}
+
+	ring_destroy( r, NULL );
+
+	pinfo( "TE: ring_split_at & ring_concat_n success");
+}
+
+void t_0F( void )
+{
+	cp in[300];
+	cp out[300];
+
+	for( uint32_t i = 0; i < 300; ++i )
+		in[i] = a+i;
+
+	Ring r = ring_from_array( in, 300 );
+
+	if( ring_size( r ) != 300 || ring_invariant( r ) || r->last != r->first + 299 )
+	{
+		perr( "T0F: from_array fail"); return;
+	}
+
+	RingView v;
+	uint64_t n;
+	uint64_t total = 0;
+
+	ring_view_init( r, &v );
+
+	while( ( n = ring_view_next( &v ) ) )
+	{
+		for( uint64_t i = 0; i < n; ++i )
+		{
+			if( v.chunk[i] != a + total + i )
+			{
+				perr( "T0F: view contend fail at %lu", (unsigned long)(total + i)); return;
+			}
+		}
+
+		total += n;
+	}
+
+	if( total != 300 )
+	{
+		perr( "T0F: view size fail"); return;
+	}
+
+	if( ring_to_array( r, out, false ) != 300 || ring_size( r ) != 300 )
+	{
+		perr( "T0F: to_array fail"); return;
+	}
+
+	ring_append( r, a+300 );
+	ring_pop( r );
+
+	if( ring_to_array( r, out, true ) != 300 || !ring_is_empty( r ) || ring_invariant( r ) )
+	{
+		perr( "T0F: to_array consume fail"); return;
+	}
+
+	for( uint32_t i = 0; i < 300; ++i )
+	{
+		if( out[i] != a + i + 1 )
+		{
+			perr( "T0F: to_array contend fail at %u", i); return;
+		}
+	}
+
+	ring_append( r, a );
+	ring_destroy( r, NULL );
+
+	r = ring_from_array( in, 0 );
+	ring_view_init( r, &v );
+
+	if( ring_view_next( &v ) || ring_to_array( r, out, true ) )
+	{
+		perr( "T0F: empty ring fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	pinfo( "TF: ring_to_array, ring_from_array & ring_view success");
+}
+
+void t_10( void )
+{
+	cp in[103];
+
+	for( uint32_t i = 0; i < 103; ++i )
+		in[i] = a + i % 10;
+
+	// contiguous arena ring, heap ring with the same contend, mixed ring
+	Ring rings[3];
+
+	rings[0] = ring_from_array( in, 103 );
+	rings[1] = ring_create();
+	rings[2] = ring_from_array( in, 103 );
+
+	for( uint32_t i = 0; i < 103; ++i )
+		ring_append( rings[1], in[i] );
+
+	ring_extract( rings[2], 50 );
+	ring_insert_at( rings[2], a+3, 50 );
+	ring_append( rings[2], a+11 );
+
+	for( int k = 0; k < 3; ++k )
+	{
+		Ring r = rings[k];
+
+		if( ring_count_eq( r, a+3 ) != 11 - ( k < 2 ) || ring_count_eq( r, a+12 ) != 0 )
+		{
+			perr( "T10: count_eq fail on ring %d", k); return;
+		}
+
+		if( ring_index_of( r, a+7 ) != 7 || ring_index_of( r, a+12 ) != -1 
+		||  ring_find( r, a+12 ) || !ring_find( r, a+2 ) )
+		{
+			perr( "T10: index_of fail on ring %d", k); return;
+		}
+
+		for( uint32_t i = 0; i < 10; ++i )
+			ring_push( r, a+100+i );
+
+		if( ring_index_of( r, a+9 ) != 19 || ring_index_of( r, a+101 ) != 8 )
+		{
+			perr( "T10: index_of after push fail on ring %d", k); return;
+		}
+	}
+
+	if( ring_index_of( rings[2], a+11 ) != 113 || ring_count_eq( rings[2], a ) != 10 )
+	{
+		perr( "T10: mixed ring fail"); return;
+	}
+
+	for( int k = 0; k < 3; ++k )
+		ring_destroy( rings[k], NULL );
+
+	pinfo( "T10: ring_find, ring_index_of & ring_count_eq success");
+}
+
+void t_11( void )
+{
+	RingPool pool = ring_pool_create( a, sizeof( *a ) );
+	PRing r1 = pring_create( pool );
+	PRing r2 = pring_create( pool );
+
+	if( sizeof( struct _PNode ) != 8 )
+	{
+		perr( "T11: node size fail"); return;
+	}
+
+	for( int i = 0; i < TEST_ARRAY_SIZE; ++i )
+	{
+		pring_append( r1, a+i );
+		pring_push( r2, a+i );
+	}
+
+	if( pring_size( r1 ) != TEST_ARRAY_SIZE || pring_invariant( r1 ) || pring_invariant( r2 ) )
+	{
+		perr( "T11: size fail"); return;
+	}
+
+	int i = 0;
+	for( pring_iterator( r1 ) )
+	{
+		if( pring_index != a + i++ )
+		{
+			perr( "T11: iterator fail at %d", i); return;
+		}
+	}
+
+	for( i = TEST_ARRAY_SIZE - 1; i >= 0; --i )
+	{
+		if( pring_pop( r2 ) != a+i )
+		{
+			perr( "T11: pop fail at %d", i); return;
+		}
+	}
+
+	if( pring_pop( r2 ) != NULL || pring_invariant( r2 ) )
+	{
+		perr( "T11: empty fail"); return;
+	}
 
+	pring_destroy( r1, NULL );
+	pring_destroy( r2, NULL );
+
+	if( pool->used )
+	{
+		perr( "T11: pool leak"); return;
+	}
+
+	ring_pool_destroy( pool );
+
+	// plain 32 bit values
+	pool = ring_pool_create( NULL, 1 );
+	r1 = pring_create( pool );
+
+	pring_append( r1, (cp)(uintptr_t)7 );
+	pring_push( r1, (cp)(uintptr_t)UINT32_MAX );
+
+	if( pring_pop( r1 ) != (cp)(uintptr_t)UINT32_MAX || pring_pop( r1 ) != (cp)(uintptr_t)7 )
+	{
+		perr( "T11: value mode fail"); return;
+	}
+
+	pring_destroy( r1, NULL );
+	ring_pool_destroy( pool );
+
+	// contend the pool can't represent is refused, not truncated
+	pool = ring_pool_create( a + 1, sizeof( *a ) );
+	r1 = pring_create( pool );
+
+	if( pring_append( r1, NULL ) || pring_push( r1, a ) || pring_append( r1, ( char* )( a + 2 ) + 1 ) ||
+		pring_push( r1, ( cp )( ( uintptr_t )( a + 1 ) + ( sizeof( *a ) << 32 ) ) ) || !pring_is_empty( r1 ) || pool->used ||
+		!pring_append( r1, a + 2 ) || pring_pop( r1 ) != a + 2 )
+	{
+		perr( "T11: pool range check fail"); return;
+	}
+
+	pring_destroy( r1, NULL );
+	ring_pool_destroy( pool );
+
+	pinfo( "T11: pring in ring_pool success");
+}
+
+#define T12_SEG 40000
+
+static int t12_released;
+
+void t_12_release( RingBuf* b, void* ud )
+{
+	*(int*)ud += 1;
+}
+
+void t_12( void )
+{
+	static char out[3][T12_SEG];
+	static char in[4][T12_SEG];
+	int fds[2];
+
+	for( int k = 0; k < 3; ++k )
+		memset( out[k], 'a' + k, T12_SEG );
+
+	// pipe: the 120k do not fit into the pipe buffer, writes are partial
+	if( pipe( fds ) || fcntl( fds[1], F_SETFL, O_NONBLOCK ) )
+	{
+		perr( "T12: pipe fail"); return;
+	}
+
+	t12_released = 0;
+	RingBufChain snd = ring_bufchain_create( t_12_release, &t12_released );
+	RingBufChain rcv = ring_bufchain_create( NULL, NULL );
+
+	for( int k = 0; k < 3; ++k )
+		ring_bufchain_add( snd, out[k], T12_SEG );
+
+	for( int k = 0; k < 4; ++k )
+		ring_bufchain_add( rcv, in[k], T12_SEG );
+
+	uint64_t got = 0;
+
+	while( ring_bufchain_pending( snd ) )
+	{
+		ssize_t w = ring_bufchain_writev( snd, fds[1] );
+		ssize_t r = ring_bufchain_readv( rcv, fds[0] );
+
+		if( w < 0 || r <= 0 || ring_bufchain_segments( snd ) + t12_released != 3 )
+		{
+			perr( "T12: pipe transfer fail"); return;
+		}
+
+		got += r;
+	}
+
+	if( got != 3 * T12_SEG || t12_released != 3 || ring_bufchain_pending( rcv ) != T12_SEG )
+	{
+		perr( "T12: pipe size fail"); return;
+	}
+
+	for( int k = 0; k < 3; ++k )
+	{
+		RingBuf b;
+
+		if( !ring_bufchain_take( rcv, &b ) || b.ptr != in[k] || b.offset != T12_SEG 
+		||  memcmp( in[k], out[k], T12_SEG ) )
+		{
+			perr( "T12: pipe contend fail in segment %d", k); return;
+		}
+	}
+
+	RingBuf b;
+
+	if( ring_bufchain_take( rcv, &b ) || ring_bufchain_segments( rcv ) != 1 )
+	{
+		perr( "T12: take on empty segment fail"); return;
+	}
+
+	ring_bufchain_destroy( snd );
+	ring_bufchain_destroy( rcv );
+	close( fds[0] );
+	close( fds[1] );
+
+	// socketpair: three small segments, one readv into one buffer
+	if( socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) )
+	{
+		perr( "T12: socketpair fail"); return;
+	}
+
+	snd = ring_bufchain_create( NULL, NULL );
+	rcv = ring_bufchain_create( NULL, NULL );
+
+	ring_bufchain_add( snd, "Hello ", 6 );
+	ring_bufchain_add( snd, "", 0 );
+	ring_bufchain_add( snd, "world", 5 );
+	ring_bufchain_add( rcv, in[0], 64 );
+
+	if( ring_bufchain_writev( snd, fds[0] ) != 11 || ring_bufchain_segments( snd ) 
+	||  ring_bufchain_readv( rcv, fds[1] ) != 11 || !ring_bufchain_take( rcv, &b )
+	||  b.offset != 11 || memcmp( b.ptr, "Hello world", 11 ) )
+	{
+		perr( "T12: socketpair transfer fail"); return;
+	}
+
+	// empty segments alone are released without a write
+	t12_released = 0;
+	ring_bufchain_destroy( snd );
+	snd = ring_bufchain_create( t_12_release, &t12_released );
+	ring_bufchain_add( snd, "", 0 );
+	ring_bufchain_add( snd, "", 0 );
+
+	if( ring_bufchain_writev( snd, fds[0] ) != 0 || ring_bufchain_segments( snd ) || t12_released != 2 )
+	{
+		perr( "T12: writev of empty segments fail"); return;
+	}
+
+	// full chain: no free space is not end of file, nothing pending writes 0
+	ring_bufchain_add( rcv, in[1], 4 );
+	ring_bufchain_add( snd, "full", 4 );
+
+	if( ring_bufchain_writev( snd, fds[0] ) != 4 || ring_bufchain_writev( snd, fds[0] ) != 0
+	||  ring_bufchain_readv( rcv, fds[1] ) != 4 )
+	{
+		perr( "T12: socketpair refill fail"); return;
+	}
+
+	errno = 0;
+
+	if( ring_bufchain_readv( rcv, fds[1] ) != -1 || errno != ENOBUFS )
+	{
+		perr( "T12: readv on full chain fail"); return;
+	}
+
+	ring_bufchain_take( rcv, &b );
+	errno = 0;
+
+	if( ring_bufchain_readv( rcv, fds[1] ) != -1 || errno != ENOBUFS || memcmp( b.ptr, "full", 4 ) )
+	{
+		perr( "T12: readv on empty chain fail"); return;
+	}
+
+	ring_bufchain_destroy( snd );
+	ring_bufchain_destroy( rcv );
+	close( fds[0] );
+	close( fds[1] );
+
+	pinfo( "T12: ring_bufchain writev & readv success");
+}
+
+
+
+void t_13( void )
+{
+	Ring r = ring_create();
+	RingNode* nodes = malloc( sizeof( *nodes ) * TEST_ARRAY_SIZE );
+	int i = 0;
+
+	// never compact on its own
+	ring_tombstone_policy( r, 0, 0 );
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+	{
+		ring_append( r, a+i );
+		nodes[i] = ring_last_node( r );
+	}
+
+	// odd elements go lazily, the last one too
+	for( i = 1; i < TEST_ARRAY_SIZE; i += 2 )
+	{
+		if( ring_tombstone( r, nodes[i] ) != a+i )
+		{
+			perr( "T13: tombstone fail at %d", i); return;
+		}
+	}
+
+	if( ring_size( r ) != TEST_ARRAY_SIZE / 2 || ring_dead( r ) != TEST_ARRAY_SIZE / 2 ||
+		ring_invariant( r ) )
+	{
+		perr( "T13: size fail"); return;
+	}
+
+	i = 0;
+	for( ring_iterator( r ) )
+	{
+		if( ring_index != a + 2*i++ )
+		{
+			perr( "T13: iterator fail at %d", i); return;
+		}
+	}
+
+	if( ring_at( r, 10 ) != a+20 || ring_last( r ) != a + TEST_ARRAY_SIZE - 2 ||
+		ring_index_of( r, a+40 ) != 20 || ring_find( r, a+41 ) )
+	{
+		perr( "T13: ring_at/ring_last/search fail"); return;
+	}
+
+	// positions count live elements only
+	if( ring_extract( r, 5 ) != a+10 || !ring_insert_at( r, a+11, 5 ) ||
+		ring_at( r, 5 ) != a+11 || ring_at( r, 6 ) != a+12 || ring_invariant( r ) )
+	{
+		perr( "T13: extract/insert fail"); return;
+	}
+
+	Ring tail = ring_split_at( r, 100 );
+
+	if( ring_size( r ) != 100 || ring_first( tail ) != a+200 ||
+		ring_dead( r ) + ring_dead( tail ) != TEST_ARRAY_SIZE / 2 ||
+		ring_invariant( r ) || ring_invariant( tail ) )
+	{
+		perr( "T13: split fail"); return;
+	}
+
+	r = ring_concat( r, tail );
+
+	// tombstones at the head go with the pop
+	ring_tombstone( r, nodes[2] );
+
+	if( ring_pop( r ) != a || ring_first( r ) != a+4 || ring_invariant( r ) )
+	{
+		perr( "T13: pop fail"); return;
+	}
+
+	ring_purge( r );
+
+	if( ring_dead( r ) || ring_size( r ) != TEST_ARRAY_SIZE / 2 - 2 || ring_invariant( r ) )
+	{
+		perr( "T13: purge fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	// compaction by ratio, a bounded number of nodes per operation
+	r = ring_create();
+	ring_tombstone_policy( r, 25, 8 );
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+	{
+		ring_append( r, a+i );
+		nodes[i] = ring_last_node( r );
+	}
+
+	for( i = 1; i < TEST_ARRAY_SIZE / 2; ++i )
+		ring_tombstone( r, nodes[i] );
+
+	if( !ring_dead( r ) || ring_dead( r ) >= TEST_ARRAY_SIZE / 2 - 1 || ring_invariant( r ) )
+	{
+		perr( "T13: incremental start fail %lu", ring_dead( r )); return;
+	}
+
+	for( i = 0; i < TEST_ARRAY_SIZE && ring_dead( r ); ++i )
+		ring_append( r, ring_pop( r ) );
+
+	if( ring_dead( r ) || ring_size( r ) != TEST_ARRAY_SIZE / 2 + 1 || ring_invariant( r ) )
+	{
+		perr( "T13: incremental compaction fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+	free( nodes );
+
+	pinfo( "T13: ring_tombstone & compaction success");
+}
+
+void t_14( void )
+{
+	Ring r = ring_create();
+	RingCursor c;
+	int i;
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_append( r, a+i );
+
+	// every call continues at the finger
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+	{
+		if( ring_at( r, i ) != a+i )
+		{
+			perr( "T14: ring_at fail at %d", i); return;
+		}
+	}
+
+	// odd elements out, finger moves back and forth
+	for( i = 1; i <= TEST_ARRAY_SIZE / 2; ++i )
+	{
+		if( ring_extract( r, i ) != a + 2*i - 1 )
+		{
+			perr( "T14: ring_extract fail at %d", i); return;
+		}
+	}
+
+	if( ring_at( r, 3 ) != a+6 || ring_at( r, 0 ) != a || ring_invariant( r ) )
+	{
+		perr( "T14: finger after extract fail"); return;
+	}
+
+	// and back in
+	for( i = 1; i < TEST_ARRAY_SIZE; i += 2 )
+	{
+		if( !ring_insert_at( r, a+i, i ) )
+		{
+			perr( "T14: ring_insert_at fail at %d", i); return;
+		}
+	}
+
+	ring_push( r, a );
+	ring_pop( r );
+
+	if( ring_size( r ) != TEST_ARRAY_SIZE || ring_at( r, TEST_ARRAY_SIZE - 1 ) != a + TEST_ARRAY_SIZE - 1 ||
+		ring_invariant( r ) )
+	{
+		perr( "T14: finger after insert fail"); return;
+	}
+
+	i = 0;
+	for( ring_iterator( r ) )
+	{
+		if( ring_index != a + i++ )
+		{
+			perr( "T14: order fail at %d", i); return;
+		}
+	}
+
+	// cursor: drop the element after every even one, double the rest
+	for( ring_cursor_init( r, &c ); ring_cursor_valid( &c ); ring_cursor_advance( &c ) )
+	{
+		if( ring_cursor_get( &c ) != a + 2*ring_cursor_pos( &c ) )
+		{
+			perr( "T14: cursor get fail at %lu", ring_cursor_pos( &c )); return;
+		}
+
+		ring_cursor_remove_after( &c );
+	}
+
+	for( ring_cursor_init( r, &c ); ring_cursor_valid( &c ); ring_cursor_advance( &c ) )
+	{
+		ring_cursor_insert_after( &c, ring_cursor_get( &c ) );
+		ring_cursor_advance( &c );
+		ring_cursor_set( &c, a+1 );
+	}
+
+	if( ring_size( r ) != TEST_ARRAY_SIZE || ring_last( r ) != a+1 || ring_at( r, 2 ) != a+2 ||
+		ring_cursor_remove_after( &c ) || ring_cursor_insert_after( &c, a ) || ring_invariant( r ) )
+	{
+		perr( "T14: cursor change fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	pinfo( "T14: finger caching & RingCursor success");
+}
+
+#define T15_ROUNDS 200
+
+static Ring t15_queue;
+static pthread_mutex_t t15_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// allocates the nodes on its own thread, the main thread frees them
+void* t_15_producer( void* moot )
+{
+	for( int k = 0; k < T15_ROUNDS; ++k )
+	{
+		Ring batch = ring_create();
+
+		for( int i = 0; i < TEST_ARRAY_SIZE; ++i )
+			ring_append( batch, a+i );
+
+		pthread_mutex_lock( &t15_lock );
+		t15_queue = ring_concat( t15_queue, batch );
+		pthread_mutex_unlock( &t15_lock );
+	}
+
+	return NULL;
+}
+
+void t_15( void )
+{
+	pthread_t producer;
+	uint64_t got = 0;
+	int i = 0;
+
+	ring_node_cache_trim( );
+	t15_queue = ring_create( );
+
+	pthread_create( &producer, NULL, t_15_producer, NULL );
+
+	while( got < (uint64_t)T15_ROUNDS * TEST_ARRAY_SIZE )
+	{
+		pthread_mutex_lock( &t15_lock );
+
+		while( !ring_is_empty( t15_queue ) )
+		{
+			if( ring_pop( t15_queue ) != a + i )
+			{
+				perr( "T15: order fail at %lu", got); return;
+			}
+
+			i = ( i + 1 ) % TEST_ARRAY_SIZE;
+			got += 1;
+		}
+
+		pthread_mutex_unlock( &t15_lock );
+	}
+
+	pthread_join( producer, NULL );
+
+	// the main thread keeps the freed nodes, the producer handed its own ones over
+	if( !ring_node_cache_trim( ) || ring_invariant( t15_queue ) )
+	{
+		perr( "T15: cache trim fail"); return;
+	}
+
+	ring_node_cache( false );
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_push( t15_queue, a+i );
+
+	ring_destroy( t15_queue, NULL );
+
+	if( ring_node_cache_trim( ) )
+	{
+		perr( "T15: cache off fail"); return;
+	}
+
+	ring_node_cache( true );
+
+	pinfo( "T15: thread local node cache success");
+}
+
+void t_16( void )
+{
+	RingArena arena = ring_arena_create_huge( 0 );
+	Ring r = ring_create_in( arena );
+	Ring h = ring_create( );
+	int i = 0;
+
+	ring_arena_destroy( arena );
+
+	for( int k = 0; k < 10; ++k )
+	{
+		for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+		{
+			ring_append( r, a+i );
+			ring_append( h, a+i );
+		}
+	}
+
+	// the first chunk starts on a huge page boundary
+	if( (uintptr_t)r->first % ( 2 << 20 ) || ring_invariant( r ) )
+	{
+		perr( "T16: huge page chunk fail"); return;
+	}
+
+	if( !ring_hugepages( h ) || ring_hugepages( h ) || ring_hugepages( r ) ||
+		ring_size( h ) != 10 * TEST_ARRAY_SIZE || ring_invariant( h ) )
+	{
+		perr( "T16: ring_hugepages fail"); return;
+	}
+
+	i = 0;
+	for( ring_iterator( h ) )
+	{
+		if( ring_index != a + i++ % TEST_ARRAY_SIZE )
+		{
+			perr( "T16: order fail at %d", i); return;
+		}
+	}
+
+	ring_append( h, a );
+	ring_pop( h );
+	r = ring_concat( r, h );
+
+	while( ring_size( r ) > TEST_ARRAY_SIZE )
+		ring_pop( r );
+
+	ring_compact( r );
+
+	if( !ring_arena_trim( ring_arena( r ) ) || ring_first( r ) != a + 1 || ring_invariant( r ) )
+	{
+		perr( "T16: trim fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	pinfo( "T16: huge page arena success");
+}
+
+static uint64_t t17_freed;
+
+void t_17_free( cp c )
+{
+	__atomic_add_fetch( &t17_freed, 1, __ATOMIC_RELAXED );
+}
+
+void t_17( void )
+{
+	RingArena arena = ring_arena_create( 0 );
+	Ring heap = ring_create( );
+	Ring priv = ring_create( );
+	Ring shared = ring_create_in( arena );
+	Ring other = ring_create_in( arena );
+	Ring step = ring_create( );
+	int calls = 0;
+
+	for( int i = 0; i < TEST_ARRAY_SIZE; ++i )
+	{
+		ring_append( heap, a+i );
+		ring_append( priv, a+i );
+		ring_append( shared, a+i );
+		ring_append( step, a+i );
+	}
+
+	// private arena, shared arena and heap ring
+	ring_compact( priv );
+	ring_arena_destroy( arena );
+
+	ring_destroy_async( heap, t_17_free );
+	ring_destroy_async( priv, t_17_free );
+	ring_destroy_async( shared, t_17_free );
+	ring_destroy_async( ring_create( ), t_17_free );
+	ring_destroy_wait( );
+
+	if( t17_freed != 3 * TEST_ARRAY_SIZE )
+	{
+		perr( "T17: async destroy fail %lu", t17_freed); return;
+	}
+
+	ring_destroy( other, NULL );
+
+	t17_freed = 0;
+
+	while( !ring_destroy_step( step, t_17_free, 300 ) )
+	{
+		if( t17_freed != 300 * (uint64_t)++calls || ring_invariant( step ) )
+		{
+			perr( "T17: ring_destroy_step fail at %d", calls); return;
+		}
+	}
+
+	if( t17_freed != TEST_ARRAY_SIZE || calls != TEST_ARRAY_SIZE / 300 )
+	{
+		perr( "T17: ring_destroy_step count fail"); return;
+	}
+
+	pinfo( "T17: ring_destroy_async & ring_destroy_step success");
+}
+
+void t_18( void )
+{
+	Ring r = ring_create();
+	RingNode mid = NULL;
+	int i = 0;
+
+	ring_rotate( r, 5 );
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+	{
+		ring_append( r, a+i );
+
+		if( i == TEST_ARRAY_SIZE / 2 )
+			mid = ring_last_node( r );
+	}
+
+	ring_rotate( r, 1 );
+	ring_rotate( r, TEST_ARRAY_SIZE + 9 );
+
+	if( ring_first( r ) != a+10 || ring_last( r ) != a+9 || ring_invariant( r ) )
+	{
+		perr( "T18: ring_rotate fail"); return;
+	}
+
+	i = 10;
+	for( ring_iterator( r ) )
+	{
+		if( ring_index != a + i )
+		{
+			perr( "T18: order fail at %d", i); return;
+		}
+
+		i = ( i + 1 ) % TEST_ARRAY_SIZE;
+	}
+
+	ring_rotate_to( r, mid );
+	ring_rotate_to( r, mid );
+
+	if( ring_first( r ) != a + TEST_ARRAY_SIZE / 2 || ring_at( r, TEST_ARRAY_SIZE / 2 ) != a ||
+		ring_invariant( r ) )
+	{
+		perr( "T18: ring_rotate_to fail"); return;
+	}
+
+	// tombstones are skipped, positions count live elements
+	for( ring_iterator( r ) )
+		if( ring_index == a+1 || ring_index == a+2 )
+			ring_tombstone( r, ring_index_node );
+
+	ring_rotate( r, TEST_ARRAY_SIZE / 2 );
+
+	if( ring_first( r ) != a || ring_at( r, 1 ) != a+3 || ring_size( r ) != TEST_ARRAY_SIZE - 2 ||
+		ring_invariant( r ) )
+	{
+		perr( "T18: rotate over tombstones fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	pinfo( "T18: ring_rotate & ring_rotate_to success");
+}
+
+
+
+void t_19_drop( cp c, void* ud )
+{
+	*( cp* )ud = c;
+}
+
+void* t_19_consumer( void* arg )
+{
+	RingSync s = arg;
+
+	for( int i = 0; i < TEST_ARRAY_SIZE; ++i )
+		if( ring_sync_pop_wait( s ) != a+i )
+			return s;
+
+	return NULL;
+}
+
+#define T19_PRODUCERS 4
+
+void* t_19_producer( void* arg )
+{
+	RingSync s = arg;
+
+	for( int i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_sync_append( s, a+i );
+
+	return NULL;
+}
+
+void* t_19_null_producer( void* arg )
+{
+	RingSync s = arg;
+
+	for( int i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_sync_append( s, NULL );
+
+	return NULL;
+}
+
+void t_19( void )
+{
+	Ring r = ring_create_bounded( 4, RING_REJECT );
+	cp last = NULL;
+	pthread_t th;
+	void* ret = NULL;
+	int i = 0;
+
+	if( ring_create_bounded( 0, RING_REJECT ) || ring_create_bounded( 4, RING_BLOCK ) )
+	{
+		perr( "T19: ring_create_bounded arguments fail"); return;
+	}
+
+	for( i = 0; i < 4; ++i )
+		ring_append( r, a+i );
+
+	if( ring_append( r, a+4 ) || ring_push( r, a+4 ) || ring_insert_at( r, a+4, 2 ) ||
+		ring_rejects( r ) != 3 || ring_size( r ) != 4 || ring_invariant( r ) )
+	{
+		perr( "T19: RING_REJECT fail"); return;
+	}
+
+	ring_pop( r );
+
+	if( !ring_append( r, a+4 ) || ring_first( r ) != a+1 || ring_last( r ) != a+4 )
+	{
+		perr( "T19: append after pop fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	r = ring_create_bounded( 4, RING_DROP_OLDEST );
+	ring_on_drop( r, t_19_drop, &last );
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_append( r, a+i );
+
+	if( ring_size( r ) != 4 || ring_drops( r ) != TEST_ARRAY_SIZE - 4 ||
+		last != a + TEST_ARRAY_SIZE - 5 || ring_first( r ) != a + TEST_ARRAY_SIZE - 4 ||
+		ring_invariant( r ) )
+	{
+		perr( "T19: RING_DROP_OLDEST fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	// the dropped head shifts the insert position
+	r = ring_create_bounded( 3, RING_DROP_OLDEST );
+
+	for( i = 0; i < 3; ++i )
+		ring_append( r, a+i );
+
+	if( !ring_insert_at( r, a+9, 1 ) || ring_at( r, 0 ) != a+9 || ring_at( r, 1 ) != a+1 ||
+		ring_at( r, 2 ) != a+2 || !ring_insert_at( r, a+8, 3 ) || ring_last( r ) != a+8 ||
+		ring_first( r ) != a+1 || ring_size( r ) != 3 || ring_invariant( r ) )
+	{
+		perr( "T19: ring_insert_at on a full RING_DROP_OLDEST ring fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	// the producer outruns the consumer and has to wait for room
+	RingSync s = ring_sync_create( 8, RING_BLOCK );
+
+	pthread_create( &th, NULL, t_19_consumer, s );
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_sync_append( s, a+i );
+
+	pthread_join( th, &ret );
+
+	if( ret || ring_sync_size( s ) || ring_sync_pop( s ) )
+	{
+		perr( "T19: RING_BLOCK fail"); return;
+	}
+
+	ring_sync_destroy( s, NULL );
+
+	// several producers waiting on a queue with room for one or two, each
+	// pop has to wake one of them
+	pthread_t prod[T19_PRODUCERS];
+
+	for( uint64_t cap = 1; cap <= 2; ++cap )
+	{
+		uint64_t sum = 0;
+
+		s = ring_sync_create( cap, RING_BLOCK );
+
+		for( i = 0; i < T19_PRODUCERS; ++i )
+			pthread_create( &prod[i], NULL, t_19_producer, s );
+
+		for( i = 0; i < T19_PRODUCERS * TEST_ARRAY_SIZE; ++i )
+			sum += *( int32_t* )ring_sync_pop_wait( s );
+
+		for( i = 0; i < T19_PRODUCERS; ++i )
+			pthread_join( prod[i], NULL );
+
+		if( sum != ( uint64_t )T19_PRODUCERS * TEST_ARRAY_SIZE * ( TEST_ARRAY_SIZE - 1 ) / 2 || ring_sync_size( s ) )
+		{
+			perr( "T19: RING_BLOCK with several producers, cap %lu fail", cap); return;
+		}
+
+		ring_sync_destroy( s, NULL );
+	}
+
+	// NULL is contend as well, popping it makes room
+	s = ring_sync_create( 1, RING_BLOCK );
+	pthread_create( &th, NULL, t_19_null_producer, s );
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+	{
+		if( ring_sync_pop_wait( s ) )
+		{
+			perr( "T19: RING_BLOCK with NULL contend fail"); return;
+		}
+	}
+
+	pthread_join( th, NULL );
+	ring_sync_destroy( s, NULL );
+
+	s = ring_sync_create( 2, RING_REJECT );
+
+	ring_sync_append( s, a );
+	ring_sync_append( s, a+1 );
+
+	if( ring_sync_append( s, a+2 ) || ring_sync_rejects( s ) != 1 || ring_sync_pop( s ) != a )
+	{
+		perr( "T19: ring_sync RING_REJECT fail"); return;
+	}
+
+	ring_sync_destroy( s, NULL );
+
+	pinfo( "T19: bounded rings success");
+}
+
+
+#define T1A_SLOTS 16
+#define T1A_MSGS 100000
+
+struct t_1A_msg
+{
+	uint64_t seq;
+	char text[40];
+};
+
+void t_1A( void )
+{
+	char name[64];
+	int status = 0;
+
+	snprintf( name, sizeof( name ), "/libring-t1a-%d", ( int )getpid( ) );
+
+	RingShm s = ring_shm_create( name, T1A_SLOTS, sizeof( struct t_1A_msg ) );
+
+	if( !s || ring_shm_create( name, 1, 1 ) || ring_shm_slot_size( s ) != sizeof( struct t_1A_msg ) )
+	{
+		perr( "T1A: ring_shm_create fail"); return;
+	}
+
+	// all slots taken, the queue is empty
+	void* slots[T1A_SLOTS];
+
+	for( int i = 0; i < T1A_SLOTS; ++i )
+		slots[i] = ring_shm_reserve( s );
+
+	if( ring_shm_reserve( s ) || ring_shm_pop( s ) || ( ( uintptr_t )slots[1] & 15 ) )
+	{
+		perr( "T1A: reserve on full segment fail"); return;
+	}
+
+	for( int i = 0; i < T1A_SLOTS; ++i )
+		ring_shm_release( s, slots[i] );
+
+	pid_t child = fork( );
+
+	if( child == 0 )
+	{
+		// the child maps the segment by name, at its own address
+		RingShm c = ring_shm_open( name );
+
+		if( !c )
+			_exit( 1 );
+
+		for( uint64_t i = 0; i < T1A_MSGS; ++i )
+		{
+			struct t_1A_msg* m = ring_shm_reserve_wait( c );
+
+			m->seq = i;
+			snprintf( m->text, sizeof( m->text ), "message %llu", ( unsigned long long )i );
+			ring_shm_append( c, m );
+		}
+
+		ring_shm_close( c );
+		_exit( 0 );
+	}
+
+	for( uint64_t i = 0; i < T1A_MSGS; ++i )
+	{
+		struct t_1A_msg* m = ring_shm_pop_wait( s );
+		char expect[40];
+
+		snprintf( expect, sizeof( expect ), "message %llu", ( unsigned long long )i );
+
+		if( m->seq != i || strcmp( m->text, expect ) )
+		{
+			perr( "T1A: message %llu fail", ( unsigned long long )i ); return;
+		}
+
+		ring_shm_release( s, m );
+	}
+
+	waitpid( child, &status, 0 );
+
+	if( !WIFEXITED( status ) || WEXITSTATUS( status ) || ring_shm_size( s ) || ring_shm_pop( s ) )
+	{
+		perr( "T1A: producer process fail"); return;
+	}
+
+	ring_shm_close( s );
+
+	if( !ring_shm_unlink( name ) || ring_shm_open( name ) )
+	{
+		perr( "T1A: ring_shm_unlink fail"); return;
+	}
+
+	pinfo( "T1A: shared memory queue success");
+}
+
+
+#define T1B_K 6
+
+int t_1B_cmp( cp x, cp y )
+{
+	return *( int32_t* )x / 4 - *( int32_t* )y / 4;
+}
+
+// ring j gets the elements i with i % 5 == j, ring 5 stays empty, ring 2 lives in an arena
+void t_1B_fill( Ring* rings, RingArena arena )
+{
+	for( int j = 0; j < T1B_K; ++j )
+		rings[j] = j == 2 ? ring_create_in( arena ) : ring_create( );
+
+	for( int i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_append( rings[i % 5], a+i );
+
+	// one tombstone, element 7 is gone
+	for( ring_iterator( rings[2] ) )
+		if( ring_index == a+7 )
+			ring_tombstone( rings[2], ring_index_node );
+}
+
+// sorted by key, equal keys in ring order
+bool t_1B_ordered( cp prev, cp c )
+{
+	int32_t p = *( int32_t* )prev;
+	int32_t i = *( int32_t* )c;
+
+	return p / 4 < i / 4 || ( p / 4 == i / 4 && p % 5 < i % 5 );
+}
+
+void t_1B( void )
+{
+	Ring rings[T1B_K];
+	RingArena arena = ring_arena_create( 64 );
+	int64_t sum = 0;
+	cp prev = NULL;
+
+	t_1B_fill( rings, arena );
+
+	Ring r = ring_merge_sorted( rings, T1B_K, t_1B_cmp );
+
+	if( ring_size( r ) != TEST_ARRAY_SIZE - 1 || ring_dead( r ) || ring_invariant( r ) )
+	{
+		perr( "T1B: ring_merge_sorted size fail"); return;
+	}
+
+	for( ring_iterator( r ) )
+	{
+		if( prev && !t_1B_ordered( prev, ring_index ) )
+		{
+			perr( "T1B: ring_merge_sorted order fail at %d", *( int32_t* )ring_index ); return;
+		}
+
+		sum += *( int32_t* )ring_index;
+		prev = ring_index;
+	}
+
+	if( sum != ( int64_t )TEST_ARRAY_SIZE * ( TEST_ARRAY_SIZE - 1 ) / 2 - 7 || ring_last( r ) != prev )
+	{
+		perr( "T1B: ring_merge_sorted contend fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	t_1B_fill( rings, arena );
+
+	RingMerge m = ring_merge_open( rings, T1B_K, t_1B_cmp );
+	uint64_t n = 0;
+	cp c;
+
+	for( prev = NULL; ( c = ring_merge_next( m ) ); prev = c, ++n )
+	{
+		if( prev && !t_1B_ordered( prev, c ) )
+		{
+			perr( "T1B: ring_merge_next order fail at %d", *( int32_t* )c ); return;
+		}
+	}
+
+	ring_merge_close( m );
+
+	if( n != TEST_ARRAY_SIZE - 1 )
+	{
+		perr( "T1B: ring_merge_next count fail"); return;
+	}
+
+	for( int j = 0; j < T1B_K; ++j )
+	{
+		if( !ring_is_empty( rings[j] ) || ring_invariant( rings[j] ) )
+		{
+			perr( "T1B: streaming input %d fail", j); return;
+		}
+
+		ring_destroy( rings[j], NULL );
+	}
+
+	r = ring_merge_sorted( rings, 0, t_1B_cmp );
+
+	if( !ring_is_empty( r ) )
+	{
+		perr( "T1B: empty merge fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	ring_arena_destroy( arena );
+
+	pinfo( "T1B: ring_merge_sorted & ring_merge_next success");
+}
+
+
+#define T1C_K 7
+
+uint64_t t_1C_mod( cp c, void* ud )
+{
+	( void )ud;
+	return ( uint64_t )*( int32_t* )c;
+}
+
+uint64_t t_1C_digit( cp c, void* ud )
+{
+	return ( uint64_t )( *( int32_t* )c >> *( int* )ud ) & 15;
+}
+
+void t_1C( void )
+{
+	Ring r = ring_create( );
+	Ring b[16];
+	int i = 0;
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_append( r, a+i );
+
+	for( ring_iterator( r ) )
+		if( ring_index == a+3 )
+			ring_tombstone( r, ring_index_node );
+
+	for( int j = 0; j < T1C_K; ++j )
+		b[j] = ring_create( );
+
+	ring_append( b[1], a+1 );
+	ring_bucketize( r, b, T1C_K, t_1C_mod, NULL );
+
+	if( !ring_is_empty( r ) || ring_dead( r ) || ring_invariant( r ) )
+	{
+		perr( "T1C: source not empty"); return;
+	}
+
+	// every bucket holds its residue class in input order, after what it had
+	for( int j = 0; j < T1C_K; ++j )
+	{
+		if( j == 1 && ring_pop( b[j] ) != a+1 )
+		{
+			perr( "T1C: old bucket contend fail"); return;
+		}
+
+		i = j;
+		for( ring_iterator( b[j] ) )
+		{
+			// element 3 was a tombstone
+			if( i == 3 )
+				i += T1C_K;
+
+			if( ring_index != a+i )
+			{
+				perr( "T1C: bucket %d order fail", j); return;
+			}
+
+			i += T1C_K;
+		}
+
+		if( i < TEST_ARRAY_SIZE || ring_invariant( b[j] ) )
+		{
+			perr( "T1C: bucket %d size fail", j); return;
+		}
+
+		ring_destroy( b[j], NULL );
+	}
+
+	// bounded buckets of 2: residue 0 refuses, residue 1 drops its oldest
+	for( i = 0; i < 12; ++i )
+		ring_append( r, a+i );
+
+	b[0] = ring_create_bounded( 2, RING_REJECT );
+	b[1] = ring_create_bounded( 2, RING_DROP_OLDEST );
+	b[2] = ring_create( );
+
+	ring_bucketize( r, b, 3, t_1C_mod, NULL );
+
+	if( ring_size( r ) != 2 || ring_pop( r ) != a+6 || ring_pop( r ) != a+9 || ring_invariant( r ) )
+	{
+		perr( "T1C: refused elements not kept in source"); return;
+	}
+
+	if( ring_size( b[0] ) != 2 || ring_first( b[0] ) != a+0 || ring_last( b[0] ) != a+3 || ring_rejects( b[0] ) != 2 
+	||  ring_size( b[1] ) != 2 || ring_first( b[1] ) != a+7 || ring_last( b[1] ) != a+10 || ring_drops( b[1] ) != 2 
+	||  ring_size( b[2] ) != 4 || ring_invariant( b[0] ) || ring_invariant( b[1] ) || ring_invariant( b[2] ) )
+	{
+		perr( "T1C: bounded bucket fail"); return;
+	}
+
+	for( int j = 0; j < 3; ++j )
+		ring_destroy( b[j], NULL );
+
+	// LSD radix sort, 3 rounds of 4 bits, shuffled input
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_insert_at( r, a+i, rand( ) % ( ring_size( r ) + 1 ) );
+
+	for( int shift = 0; shift < 12; shift += 4 )
+	{
+		for( int j = 0; j < 16; ++j )
+			b[j] = ring_create( );
+
+		ring_bucketize( r, b, 16, t_1C_digit, &shift );
+
+		for( int j = 0; j < 16; ++j )
+			r = ring_concat( r, b[j] );
+	}
+
+	i = 0;
+	for( ring_iterator( r ) )
+	{
+		if( ring_index != a + i++ )
+		{
+			perr( "T1C: radix sort fail at %d", i - 1); return;
+		}
+	}
+
+	if( i != TEST_ARRAY_SIZE || ring_invariant( r ) )
+	{
+		perr( "T1C: radix sort size fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	pinfo( "T1C: ring_bucketize success");
+}
+
+
+void t_1D_drop( cp c, void* ud )
+{
+	( void )c;
+	*( uint64_t* )ud += 1;
+}
+
+void t_1D_sleep( long ns )
+{
+	struct timespec ts = { 0, ns };
+	nanosleep( &ts, NULL );
+}
+
+uint64_t t_1D_freed = 0;
+
+void t_1D_free( cp c )
+{
+	( void )c;
+	t_1D_freed += 1;
+}
+
+bool t_1D_all( cp c, void* ud )
+{
+	( void )c;
+	( void )ud;
+	return true;
+}
+
+// Ring with 200 elements in CoDel dropping state
+Ring t_1D_dropping( uint64_t* dropped )
+{
+	Ring r = ring_create( );
+
+	ring_sojourn_enable( r );
+	ring_codel( r, 1000000, 5000000, t_1D_drop, dropped );
+
+	for( int i = 0; i < 200; ++i )
+		ring_append( r, a+i );
+
+	t_1D_sleep( 7000000 );
+	ring_pop( r );
+	t_1D_sleep( 6000000 );
+	ring_pop( r );
+
+	// past the next drop time
+	t_1D_sleep( 6000000 );
+
+	return r;
+}
+
+void t_1D( void )
+{
+	Ring r = ring_create( );
+	uint64_t hist[RING_SOJOURN_BUCKETS];
+	uint64_t dropped = 0, total = 0;
+
+#ifndef RING_SOJOURN
+	if( ring_sojourn_enable( r ) || ring_codel( r, 1, 1, NULL, NULL ) || ring_sojourn_quantile( r, 0.5 ) )
+	{
+		perr( "T1D: sojourn without RING_SOJOURN fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	pinfo( "T1D: sojourn tracking not built in success");
+	return;
+#endif
+
+	if( !ring_sojourn_enable( r ) )
+	{
+		perr( "T1D: ring_sojourn_enable fail"); return;
+	}
+
+	for( int i = 0; i < 100; ++i )
+		ring_append( r, a+i );
+
+	t_1D_sleep( 2000000 );
+
+	for( int i = 0; i < 100; ++i )
+		ring_pop( r );
+
+	ring_sojourn_histogram( r, hist );
+
+	for( int b = 0; b < RING_SOJOURN_BUCKETS; ++b )
+		total += hist[b];
+
+	if( total != 100 || ring_sojourn_quantile( r, 0.5 ) < 2000000 || ring_sojourn_quantile( r, 1 ) > 1000000000 )
+	{
+		perr( "T1D: sojourn histogram fail"); return;
+	}
+
+	ring_sojourn_reset( r );
+
+	if( ring_sojourn_quantile( r, 0.5 ) )
+	{
+		perr( "T1D: ring_sojourn_reset fail"); return;
+	}
+
+	// a standing queue: two in, one out per ms, 1 ms target
+	ring_codel( r, 1000000, 5000000, t_1D_drop, &dropped );
+
+	for( int i = 0; i < 50; ++i )
+	{
+		ring_append( r, a+i );
+		ring_append( r, a+i );
+		ring_pop( r );
+		t_1D_sleep( 1000000 );
+	}
+
+	if( !dropped || dropped != ring_codel_drops( r ) || ring_invariant( r ) )
+	{
+		perr( "T1D: CoDel drop fail"); return;
+	}
+
+	// no drops once the queue drains quickly
+	while( !ring_is_empty( r ) )
+		ring_pop( r );
+
+	dropped = ring_codel_drops( r );
+
+	for( int i = 0; i < 1000; ++i )
+	{
+		ring_append( r, a+i );
+		ring_pop( r );
+	}
+
+	if( ring_codel_drops( r ) != dropped )
+	{
+		perr( "T1D: CoDel idle drop fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	// elements added before the tracking and from an array have no stamp,
+	// they are neither counted nor dropped
+	static cp arr[100];
+
+	for( int i = 0; i < 100; ++i )
+		arr[i] = a+i;
+
+	Ring rings[2] = { ring_create( ), ring_from_array( arr, 100 ) };
+
+	for( int i = 0; i < 100; ++i )
+		ring_append( rings[0], a+i );
+
+	for( int k = 0; k < 2; ++k )
+	{
+		r = rings[k];
+		dropped = 0;
+		total = 0;
+
+		ring_codel( r, 1, 1000000, t_1D_drop, &dropped );
+		ring_append( r, a );
+		t_1D_sleep( 2000000 );
+
+		for( int i = 0; i < 101; ++i )
+		{
+			if( ring_pop( r ) != ( i < 100 ? a+i : a ) )
+			{
+				perr( "T1D: pop of unstamped element %d fail", i); return;
+			}
+
+			t_1D_sleep( i ? 0 : 2000000 );
+		}
+
+		ring_sojourn_histogram( r, hist );
+
+		for( int b = 0; b < RING_SOJOURN_BUCKETS; ++b )
+			total += hist[b];
+
+		if( dropped || total != 1 || ring_sojourn_quantile( r, 1 ) > 1000000000 )
+		{
+			perr( "T1D: sojourn of unstamped elements fail"); return;
+		}
+
+		ring_destroy( r, NULL );
+	}
+
+	// only ring_pop drops, the other removals take what they are asked for
+	dropped = 0;
+	r = t_1D_dropping( &dropped );
+
+	cp first = ring_first( r );
+	cp second = ring_at( r, 1 );
+	uint64_t size = ring_size( r );
+
+	if( !dropped || ring_extract( r, 0 ) != first || ring_tombstone( r, r->first ) != second ||
+		ring_size( r ) != size - 2 || ring_codel_drops( r ) != dropped || ring_invariant( r ) )
+	{
+		perr( "T1D: extract & tombstone while dropping fail"); return;
+	}
+
+	Ring sel = ring_remove_selected( r, t_1D_all, NULL );
+
+	if( ring_size( sel ) != size - 2 || !ring_is_empty( r ) || ring_codel_drops( r ) != dropped )
+	{
+		perr( "T1D: ring_remove_selected while dropping fail"); return;
+	}
+
+	ring_destroy( sel, NULL );
+	ring_destroy( r, NULL );
+
+	dropped = 0;
+	r = t_1D_dropping( &dropped );
+	size = ring_size( r );
+	t_1D_freed = 0;
+
+	while( !ring_destroy_step( r, t_1D_free, 16 ) )
+		;
+
+	if( !dropped || t_1D_freed != size )
+	{
+		perr( "T1D: ring_destroy_step while dropping fail"); return;
+	}
+
+	pinfo( "T1D: sojourn tracking & CoDel success");
+}
+
+
+void t_1E( void )
+{
+	RingArena arena = ring_arena_create_numa( 64, 0 );
+	Ring r = ring_create( );
+	int i = 0;
+
+	if( !arena )
+	{
+		// no memory policy syscalls here (seccomp), nothing to place
+		if( ring_migrate( r, 0 ) || ring_numa_node( r ) != -1 )
+		{
+			perr( "T1E: NUMA fallback fail"); return;
+		}
+
+		ring_destroy( r, NULL );
+		pinfo( "T1E: NUMA not available success");
+		return;
+	}
+
+	if( ring_arena_create_numa( 0, -1 ) || ring_arena_create_numa( 0, 1 << 20 ) )
+	{
+		perr( "T1E: invalid NUMA node fail"); return;
+	}
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_append( r, a+i );
+
+	for( ring_iterator( r ) )
+		if( ring_index == a+5 )
+			ring_tombstone( r, ring_index_node );
+
+	RingNode before = r->first;
+
+	// node 0 exists everywhere, the last possible one hardly ever
+	if( ring_numa_node( r ) != -1 || ring_migrate( r, 1023 ) || r->first != before ||
+		!ring_migrate( r, 0 ) || r->first == before || ring_numa_node( r ) != 0 ||
+		ring_numa_locate( r->first ) != 0 || ring_numa_locate( r->last ) != 0 )
+	{
+		perr( "T1E: ring_migrate fail"); return;
+	}
+
+	i = 0;
+	for( ring_iterator( r ) )
+	{
+		if( ring_index != a + i + ( i >= 5 ) )
+		{
+			perr( "T1E: migrated contend fail at %d", i); return;
+		}
+
+		++i;
+	}
+
+	if( i != TEST_ARRAY_SIZE - 1 || ring_dead( r ) || ring_invariant( r ) )
+	{
+		perr( "T1E: migrated size fail"); return;
+	}
+
+	// from one NUMA arena into another one
+	if( !ring_migrate( r, 0 ) || ring_size( r ) != TEST_ARRAY_SIZE - 1 || ring_invariant( r ) )
+	{
+		perr( "T1E: second ring_migrate fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	r = ring_create_in( arena );
+
+	for( i = 0; i < TEST_ARRAY_SIZE; ++i )
+		ring_push( r, a+i );
+
+	if( ring_numa_node( r ) != 0 || ring_numa_locate( r->first ) != 0 || ring_first( r ) != a + TEST_ARRAY_SIZE - 1 )
+	{
+		perr( "T1E: NUMA arena fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+	ring_arena_destroy( arena );
+
+	pinfo( "T1E: NUMA arenas & ring_migrate success");
+}
+struct Pair
+{
+	int64_t key;
+	double value;
+};
+
+RING_DEFINE(IntRing, int32_t)
+RING_DEFINE(PairRing, struct Pair)
+
+void t_1F(void)
+{
+	IntRing r = IntRing_create();
+	int32_t v = 0;
+
+	if (!IntRing_is_empty(r) || IntRing_pop(r, &v) || IntRing_chop(r, &v) || IntRing_first(r) || IntRing_last(r))
+	{
+		perr("T1F: empty typed ring fail");
+		return;
+	}
+
+	for (int32_t i = 0; i < 100; ++i)
+		IntRing_append(r, i);
+
+	IntRing_push(r, -1);
+
+	if (IntRing_size(r) != 101 || *IntRing_first(r) != -1 || *IntRing_last(r) != 99 ||
+			*IntRing_at(r, 51) != 50 || IntRing_at(r, 101))
+	{
+		perr("T1F: typed push/append/at fail");
+		return;
+	}
+
+	int32_t i = -1;
+
+	for (ring_typed_iterator(IntRing, r))
+	{
+		if (ring_typed_index != i++)
+		{
+			perr("T1F: typed iterator fail at %d", i);
+			return;
+		}
+
+		ring_typed_index *= 2;
+	}
+
+	if (!IntRing_pop(r, &v) || v != -2 || !IntRing_chop(r, &v) || v != 198 || !IntRing_pop(r, NULL) ||
+			IntRing_size(r) != 98 || *IntRing_first(r) != 2 || *IntRing_last(r) != 196)
+	{
+		perr("T1F: typed pop/chop fail");
+		return;
+	}
+
+	IntRing e = IntRing_create();
+
+	r = IntRing_concat(r, e);
+	e = IntRing_create();
+	IntRing_append(e, 7);
+	e = IntRing_concat(e, r);
+
+	if (IntRing_size(e) != 99 || *IntRing_first(e) != 7 || *IntRing_last(e) != 196)
+	{
+		perr("T1F: typed concat fail");
+		return;
+	}
+
+	while (IntRing_chop(e, &v))
+		;
+
+	if (e->first || e->last || IntRing_size(e))
+	{
+		perr("T1F: typed ring not empty after chop");
+		return;
+	}
+
+	IntRing_append(e, 1);
+	IntRing_destroy(e);
+
+	// 16 byte values are copied in and out
+	PairRing p = PairRing_create();
+	struct Pair x = { 3, 0.5 };
+
+	PairRing_append(p, x);
+	x.key = 4;
+	PairRing_push(p, x);
+	PairRing_first(p)->value = 2.5;
+
+	if (!PairRing_pop(p, &x) || x.key != 4 || x.value != 2.5 || PairRing_last(p)->key != 3 ||
+			PairRing_last(p)->value != 0.5)
+	{
+		perr("T1F: typed struct ring fail");
+		return;
+	}
+
+	PairRing_destroy(p);
+
+	pinfo("T1F: RING_DEFINE typed rings success");
+}
+
+void* t_20_producer( void* arg )
+{
+	RingSync s = arg;
+
+	for( int i = 0; i < TEST_ARRAY_SIZE; ++i )
+	{
+		ring_sync_append( s, a+i );
+
+		if( i % 64 == 0 )
+			sched_yield( );
+	}
+
+	return NULL;
+}
+
+void t_20( void )
+{
+	RingSync s = ring_sync_create( 0, RING_REJECT );
+	uint64_t count = 0;
+	pthread_t th;
+	int i = 0;
+
+	ring_sync_append( s, a );
+
+	int fd = ring_sync_fd( s );
+
+	if( fd < 0 )
+	{
+		pwarn( "T20: no eventfd, skipped");
+		ring_sync_destroy( s, NULL );
+		return;
+	}
+
+	// the element from before the fd existed is signaled as well
+	ring_sync_append( s, a+1 );
+	ring_sync_append( s, a+2 );
+
+	if( ring_sync_fd( s ) != fd || ring_sync_signals( s ) != 1 || read( fd, &count, sizeof( count ) ) != 8 ||
+		count != 1 )
+	{
+		perr( "T20: signal on the empty to non-empty transition only fail"); return;
+	}
+
+	Ring r = ring_sync_pop_all( s );
+
+	if( ring_size( r ) != 3 || ring_first( r ) != a || ring_last( r ) != a+2 || ring_sync_size( s ) ||
+		read( fd, &count, sizeof( count ) ) != -1 )
+	{
+		perr( "T20: ring_sync_pop_all fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	ring_sync_append( s, a+3 );
+	r = ring_sync_pop_all( s );
+
+	if( ring_sync_signals( s ) != 2 || ring_first( r ) != a+3 || read( fd, &count, sizeof( count ) ) != -1 )
+	{
+		perr( "T20: pop_all resets the fd fail"); return;
+	}
+
+	ring_destroy( r, NULL );
+
+	// epoll consumer against a producer thread, nothing lost, order kept
+	int ep = epoll_create1( 0 );
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = s };
+
+	epoll_ctl( ep, EPOLL_CTL_ADD, fd, &ev );
+	pthread_create( &th, NULL, t_20_producer, s );
+
+	while( i < TEST_ARRAY_SIZE )
+	{
+		if( epoll_wait( ep, &ev, 1, 5000 ) != 1 )
+		{
+			perr( "T20: epoll_wait timed out at %d", i); return;
+		}
+
+		r = ring_sync_pop_all( s );
+
+		for( ring_iterator( r ) )
+			if( ring_index != a + i++ )
+			{
+				perr( "T20: order fail at %d", i); return;
+			}
+
+		ring_destroy( r, NULL );
+	}
+
+	pthread_join( th, NULL );
+	close( ep );
+
+	if( ring_sync_signals( s ) > 2 + TEST_ARRAY_SIZE || ring_sync_size( s ) )
+	{
+		perr( "T20: signal count fail"); return;
+	}
+
+	ring_sync_destroy( s, NULL );
+
+	pinfo( "T20: ring_sync_fd & ring_sync_pop_all success");
+}
 
 
 
@@ -673,6 +2857,28 @@ int main( void )
 	tests[8] = t_08;
 	tests[9] = t_09;
 	tests[10] = t_0A;
+	tests[11] = t_0B;
+	tests[12] = t_0C;
+	tests[13] = t_0D;
+	tests[14] = t_0E;
+	tests[15] = t_0F;
+	tests[16] = t_10;
+	tests[17] = t_11;
+	tests[18] = t_12;
+	tests[19] = t_13;
+	tests[20] = t_14;
+	tests[21] = t_15;
+	tests[22] = t_16;
+	tests[23] = t_17;
+	tests[24] = t_18;
+	tests[25] = t_19;
+	tests[26] = t_1A;
+	tests[27] = t_1B;
+	tests[28] = t_1C;
+	tests[29] = t_1D;
+	tests[30] = t_1E;
+	tests[31] = t_1F;
+	tests[32] = t_20;
 
 	for ( int i = 0; i < TEST_FUNC_ARRAY_SIZE ; ++i )
 		if( tests[i] )
@@ -0,0 +1,412 @@
+/**
+ * @file Unit tests of the block deque backend (ring_deque.h)
+ * @author Markus Wanke
+ */
+
+#define _GNU_SOURCE
+
+/* ---- System Header -------------------------------------------------------------- */
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- Own Header ----------------------------------------------------------------- */
+#include "ring_deque.h"
+
+/* ---- Helper Functions ----------------------------------------------------------- */
+
+#define ES_none   "\033[0m"
+#define ES_bold   "\033[1m"
+#define ES_red    "\033[31m"
+#define ES_blue   "\033[34m"
+#define ES_white  "\033[37m"
+#define pinfo(format, ...) fprintf(stderr, ES_bold ES_blue "INFO " ES_none ES_white format ES_none "\n", ## __VA_ARGS__)
+#define perr(format, ...)  fprintf(stderr, ES_bold ES_red "ERROR " ES_none ES_red format ES_none "\n", ## __VA_ARGS__)
+
+/* ---- Test Functions ----------------------------------------------------------- */
+
+#define TEST_FUNC_ARRAY_SIZE 64
+#define TEST_ARRAY_SIZE 5000
+
+void( *tests[TEST_FUNC_ARRAY_SIZE] )( void );
+
+int32_t a[TEST_ARRAY_SIZE];
+
+// Same contend as the array model m of n elements
+static bool same(Ring r, cp* m, uint64_t n)
+{
+	uint64_t i = 0;
+
+	if (ring_size(r) != n || ring_invariant(r))
+		return false;
+
+	for (ring_iterator(r))
+		if (ring_index != m[i++])
+			return false;
+
+	for (i = 0; i < n; ++i)
+		if (ring_at(r, i) != m[i])
+			return false;
+
+	return true;
+}
+
+static bool even(cp c, void* ud)
+{
+	(void)ud;
+	return *(int32_t*)c % 2 == 0;
+}
+
+void t_01(void)
+{
+	Ring r = ring_create();
+
+	// several blocks in both directions
+	for (int i = 0; i < TEST_ARRAY_SIZE / 2; ++i)
+		ring_push(r, a + TEST_ARRAY_SIZE / 2 - 1 - i);
+
+	for (int i = TEST_ARRAY_SIZE / 2; i < TEST_ARRAY_SIZE; ++i)
+		ring_append(r, a + i);
+
+	if (ring_size(r) != TEST_ARRAY_SIZE || ring_invariant(r))
+	{
+		perr("T1: push & append size fail");
+		return;
+	}
+
+	for (int i = 0; i < TEST_ARRAY_SIZE; ++i)
+		if (ring_at(r, i) != a + i)
+		{
+			perr("T1: ring_at fail at %d", i);
+			return;
+		}
+
+	if (ring_first(r) != a || ring_last(r) != a + TEST_ARRAY_SIZE - 1 || ring_at(r, TEST_ARRAY_SIZE))
+	{
+		perr("T1: first/last/out of bounds fail");
+		return;
+	}
+
+	for (int i = 0; i < TEST_ARRAY_SIZE / 2; ++i)
+		if (ring_pop(r) != a + i || ring_chop(r) != a + TEST_ARRAY_SIZE - 1 - i)
+		{
+			perr("T1: pop & chop fail at %d", i);
+			return;
+		}
+
+	if (!ring_is_empty(r) || ring_pop(r) || ring_chop(r) || ring_invariant(r))
+	{
+		perr("T1: ring not empty");
+		return;
+	}
+
+	// fifo through the kept block, the map must not grow
+	uint64_t map_size = r->map_size;
+
+	for (int i = 0; i < 100 * RING_DEQUE_BLOCK; ++i)
+	{
+		ring_append(r, a + i % TEST_ARRAY_SIZE);
+
+		if (ring_pop(r) != a + i % TEST_ARRAY_SIZE)
+		{
+			perr("T1: fifo fail at %d", i);
+			return;
+		}
+	}
+
+	if (r->map_size != map_size || ring_invariant(r))
+	{
+		perr("T1: fifo map grew to %lu", r->map_size);
+		return;
+	}
+
+	ring_destroy(r, NULL);
+
+	pinfo("T1: ring_push, ring_append, ring_pop, ring_chop & ring_at success");
+}
+
+void t_02(void)
+{
+	static cp m[TEST_ARRAY_SIZE];
+	uint64_t n = 0;
+	Ring r = ring_create();
+
+	srand(7);
+
+	// random positional changes against an array
+	for (int step = 0; step < 20000; ++step)
+	{
+		uint64_t i = n ? (uint64_t)rand() % (n + 1) : 0;
+		cp c = a + rand() % TEST_ARRAY_SIZE;
+
+		if (n < 3 * TEST_ARRAY_SIZE / 4 && rand() % 2)
+		{
+			if (!ring_insert_at(r, c, i))
+			{
+				perr("T2: ring_insert_at refused %lu", i);
+				return;
+			}
+
+			memmove(m + i + 1, m + i, (n - i) * sizeof(cp));
+			m[i] = c;
+			n += 1;
+		}
+		else if (n)
+		{
+			i %= n;
+
+			if (ring_extract(r, i) != m[i])
+			{
+				perr("T2: ring_extract fail at %lu", i);
+				return;
+			}
+
+			memmove(m + i, m + i + 1, (n - i - 1) * sizeof(cp));
+			n -= 1;
+		}
+
+		if (step % 97 == 0 && !same(r, m, n))
+		{
+			perr("T2: ring differs after step %d", step);
+			return;
+		}
+	}
+
+	if (!same(r, m, n) || ring_insert_at(r, a, n + 1) || ring_extract(r, n))
+	{
+		perr("T2: final state or bounds fail");
+		return;
+	}
+
+	ring_destroy(r, NULL);
+
+	pinfo("T2: ring_insert_at & ring_extract success");
+}
+
+void t_03(void)
+{
+	static cp m[TEST_ARRAY_SIZE];
+	Ring r = ring_create();
+
+	for (int i = 0; i < 1500; ++i)
+	{
+		ring_append(r, a + i);
+		m[i] = a + i;
+	}
+
+	// rotate both ways
+	ring_rotate(r, 100);
+	ring_rotate(r, 1400);
+	ring_rotate(r, 3 * 1500);
+
+	if (!same(r, m, 1500))
+	{
+		perr("T3: ring_rotate fail");
+		return;
+	}
+
+	ring_rotate(r, 1499);
+
+	if (ring_first(r) != a + 1499 || ring_last(r) != a + 1498)
+	{
+		perr("T3: ring_rotate by n - 1 fail");
+		return;
+	}
+
+	ring_rotate(r, 1);
+
+	// split on both sides of the middle, concat back
+	for (uint64_t at = 0; at <= 1500; at += 250)
+	{
+		Ring s = ring_split_at(r, at);
+
+		if (ring_size(r) != at || ring_size(s) != 1500 - at || ring_invariant(r) || ring_invariant(s) ||
+				(at && ring_last(r) != a + at - 1) || (at < 1500 && ring_first(s) != a + at))
+		{
+			perr("T3: ring_split_at %lu fail", at);
+			return;
+		}
+
+		r = ring_concat(r, s);
+
+		if (!same(r, m, 1500))
+		{
+			perr("T3: ring_concat after split at %lu fail", at);
+			return;
+		}
+	}
+
+	if (ring_split_at(r, 1501))
+	{
+		perr("T3: ring_split_at out of bounds fail");
+		return;
+	}
+
+	// the second concat has the smaller ring in front
+	Ring rings[3];
+
+	rings[2] = ring_split_at(r, 10);
+	rings[1] = ring_split_at(r, 5);
+	rings[0] = r;
+
+	r = ring_concat_n(rings, 3);
+
+	if (!same(r, m, 1500))
+	{
+		perr("T3: ring_concat_n fail");
+		return;
+	}
+
+	ring_destroy(r, NULL);
+
+	pinfo("T3: ring_rotate, ring_split_at & ring_concat success");
+}
+
+void t_04(void)
+{
+	static cp m[TEST_ARRAY_SIZE];
+	static cp out[TEST_ARRAY_SIZE];
+
+	for (int i = 0; i < TEST_ARRAY_SIZE; ++i)
+		m[i] = a + i;
+
+	Ring r = ring_from_array(m, TEST_ARRAY_SIZE);
+
+	ring_pop(r);
+	ring_push(r, a);
+
+	if (!same(r, m, TEST_ARRAY_SIZE))
+	{
+		perr("T4: ring_from_array fail");
+		return;
+	}
+
+	ring_append(r, a + 7);
+
+	if (!ring_find(r, a + 4999) || ring_find(r, (cp)&r) || ring_index_of(r, a + 7) != 7 ||
+			ring_index_of(r, NULL) != -1 || ring_count_eq(r, a + 7) != 2)
+	{
+		perr("T4: ring_find, ring_index_of or ring_count_eq fail");
+		return;
+	}
+
+	ring_chop(r);
+
+	Ring ev = ring_remove_selected(r, even, NULL);
+
+	if (ring_size(ev) != TEST_ARRAY_SIZE / 2 || ring_size(r) != TEST_ARRAY_SIZE / 2 ||
+			ring_invariant(r) || ring_invariant(ev))
+	{
+		perr("T4: ring_remove_selected size fail");
+		return;
+	}
+
+	for (int i = 0; i < TEST_ARRAY_SIZE / 2; ++i)
+		if (ring_at(ev, i) != a + 2 * i || ring_at(r, i) != a + 2 * i + 1)
+		{
+			perr("T4: ring_remove_selected order fail at %d", i);
+			return;
+		}
+
+	r = ring_concat(r, ev);
+
+	if (ring_to_array(r, out, true) != TEST_ARRAY_SIZE || !ring_is_empty(r) || ring_invariant(r) ||
+			out[0] != a + 1 || out[TEST_ARRAY_SIZE - 1] != a + TEST_ARRAY_SIZE - 2)
+	{
+		perr("T4: ring_to_array fail");
+		return;
+	}
+
+	ring_append(r, a);
+
+	if (ring_first(r) != a || ring_size(r) != 1)
+	{
+		perr("T4: reuse after ring_to_array fail");
+		return;
+	}
+
+	ring_destroy(r, NULL);
+
+	pinfo("T4: ring_from_array, ring_to_array, searches & ring_remove_selected success");
+}
+
+void t_05(void)
+{
+	static cp m[TEST_ARRAY_SIZE];
+
+	for (int i = 0; i < TEST_ARRAY_SIZE; ++i)
+		m[i] = a + i;
+
+	Ring r = ring_from_array(m, TEST_ARRAY_SIZE);
+	Ring d = ring_distribute(r, 7);
+
+	if (ring_size(d) != 7 || ring_invariant(d) || !same(r, m, TEST_ARRAY_SIZE))
+	{
+		perr("T5: ring_distribute size fail");
+		return;
+	}
+
+	for (uint64_t k = 0; k < 7; ++k)
+	{
+		Ring part = ring_at(d, k);
+
+		if (ring_size(part) != (TEST_ARRAY_SIZE - k + 6) / 7 || ring_invariant(part))
+		{
+			perr("T5: ring_distribute part %lu size fail", k);
+			return;
+		}
+
+		for (uint64_t i = 0; i < ring_size(part); ++i)
+			if (ring_at(part, i) != a + k + 7 * i)
+			{
+				perr("T5: ring_distribute part %lu fail at %lu", k, i);
+				return;
+			}
+
+		ring_destroy(part, NULL);
+	}
+
+	ring_destroy(d, NULL);
+
+	// no rings is one ring
+	d = ring_distribute(r, 0);
+
+	if (ring_size(d) != 1 || !same(ring_first(d), m, TEST_ARRAY_SIZE))
+	{
+		perr("T5: ring_distribute into 0 rings fail");
+		return;
+	}
+
+	ring_destroy(ring_first(d), NULL);
+	ring_destroy(d, NULL);
+	ring_destroy(r, NULL);
+
+	pinfo("T5: ring_distribute success");
+}
+
+
+
+int main( void )
+{
+	// just in case
+	for ( int i = 0; i < TEST_FUNC_ARRAY_SIZE ; ++i )
+		tests[i] = NULL;
+
+	for ( int i = 0; i < TEST_ARRAY_SIZE ; ++i )
+		a[i] = i;
+
+	// 0 reserved
+	tests[1] = t_01;
+	tests[2] = t_02;
+	tests[3] = t_03;
+	tests[4] = t_04;
+	tests[5] = t_05;
+
+	for ( int i = 0; i < TEST_FUNC_ARRAY_SIZE ; ++i )
+		if( tests[i] )
+			( *tests[i] )( );
+
+	return 0;
+}